@@ -0,0 +1,117 @@
+/**
+ * File: stsh-command-hash.cc
+ * --------------------------
+ * Presents the implementation of the STSHCommandHash class.
+ */
+
+#include "stsh-command-hash.h"
+#include <algorithm>
+#include <iomanip>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/stat.h>
+using namespace std;
+
+static const char *const kDefaultPath = "/bin:/usr/bin";
+
+/**
+ * Function: splitPath
+ * -------------------
+ * Breaks the provided PATH value into its directories, where an empty
+ * directory stands for the current one.
+ */
+static vector<string> splitPath(const string& path) {
+  vector<string> dirs;
+  size_t start = 0;
+  while (true) {
+    size_t end = path.find(':', start);
+    dirs.push_back(path.substr(start, end == string::npos ? string::npos : end - start));
+    if (end == string::npos) return dirs;
+    start = end + 1;
+  }
+}
+
+/**
+ * Function: getModificationTime
+ * -----------------------------
+ * Returns the modification time of the provided directory, or a zeroed-out
+ * time if it doesn't exist.
+ */
+static struct timespec getModificationTime(const string& dir) {
+  struct stat st;
+  if (stat(dir.empty() ? "." : dir.c_str(), &st) == -1) return timespec();
+  return st.st_mtim;
+}
+
+static bool isExecutable(const string& file) {
+  struct stat st;
+  return stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode) && access(file.c_str(), X_OK) == 0;
+}
+
+bool STSHCommandHash::lookup(const string& name, string& path) {
+  if (name.find('/') != string::npos) {
+    path = name;
+    return true;
+  }
+
+  const char *current = getenv("PATH");
+  if (current == NULL) current = kDefaultPath;
+  if (this->path != current) reset(current);
+  auto found = entries.find(name);
+  if (found == entries.end()) {
+    entry e = {"", 0};
+    for (const string& dir: splitPath(this->path)) {
+      string candidate = dir.empty() ? name : dir + "/" + name;
+      if (isExecutable(candidate)) {
+        e.path = candidate;
+        break;
+      }
+    }
+
+    found = entries.insert(make_pair(name, e)).first;
+  }
+
+  found->second.hits++;
+  path = found->second.path;
+  return !path.empty();
+}
+
+bool STSHCommandHash::revalidate() {
+  vector<string> dirs = splitPath(path);
+  for (size_t i = 0; i < dirs.size() && i < mtimes.size(); i++) {
+    struct timespec mtime = getModificationTime(dirs[i]);
+    if (mtime.tv_sec != mtimes[i].tv_sec || mtime.tv_nsec != mtimes[i].tv_nsec) {
+      reset(path.c_str());
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void STSHCommandHash::clear() {
+  entries.clear();
+}
+
+void STSHCommandHash::reset(const char *path) {
+  entries.clear();
+  this->path = path;
+  mtimes.clear();
+  for (const string& dir: splitPath(this->path)) mtimes.push_back(getModificationTime(dir));
+}
+
+ostream& operator<<(ostream& os, const STSHCommandHash& hash) {
+  vector<string> names;
+  for (const pair<const string, STSHCommandHash::entry>& p: hash.entries) names.push_back(p.first);
+  sort(names.begin(), names.end());
+  os << "hits" << "    " << "command" << endl;
+  for (const string& name: names) {
+    const STSHCommandHash::entry& e = hash.entries.find(name)->second;
+    os << setw(4) << e.hits << "    ";
+    if (e.path.empty()) os << name << " (not found)";
+    else os << e.path;
+    os << endl;
+  }
+
+  return os;
+}
@@ -0,0 +1,79 @@
+/**
+ * File: stsh-command-hash.h
+ * -------------------------
+ * Defines the STSHCommandHash class, which remembers where in PATH
+ * each command was found (ala bash's hash builtin), so that launching the same
+ * command again doesn't repeat the walk over PATH.  Commands that aren't found
+ * anywhere are remembered as well, so reporting the same missing command again
+ * costs nothing.
+ *
+ * Everything the hash knows is forgotten whenever PATH changes, or whenever
+ * one of the directories in PATH is modified (which is what happens when an executable
+ * is added to it or removed from it).
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <iostream>
+#include <time.h>
+
+class STSHCommandHash {
+
+/**
+ * Function: operator<<
+ * Usage: cout << hash;
+ * --------------------
+ * Lists every command the hash knows about, along with the number of times
+ * it's been looked up and where it was found.
+ */
+  friend std::ostream& operator<<(std::ostream& os, const STSHCommandHash& hash);
+
+public:
+
+/**
+ * Method: lookup
+ * --------------
+ * Places the path of the executable to be run for the named command in path, and
+ * returns true, or returns false if there's no such command in PATH.  Names that
+ * include a slash are never looked up in PATH; they're returned as is.
+ */
+  bool lookup(const std::string& name, std::string& path);
+
+/**
+ * Method: revalidate
+ * ------------------
+ * Forgets everything if any of the directories in PATH has been modified since
+ * the hash last checked, and returns true iff it did.  This stats every directory
+ * in PATH, so it's meant to be called once per pipeline, not once per lookup.
+ */
+  bool revalidate();
+
+/**
+ * Method: clear
+ * -------------
+ * Forgets everything.
+ */
+  void clear();
+
+/**
+ * Method: empty
+ * -------------
+ * Returns true iff the hash doesn't know about any commands.
+ */
+  bool empty() const { return entries.empty(); }
+
+private:
+  struct entry {
+    std::string path; // empty if the command wasn't found
+    size_t hits;
+  };
+
+  std::unordered_map<std::string, entry> entries;
+  std::string path; // the value of PATH when the entries were resolved
+  std::vector<struct timespec> mtimes; // modification times of each directory in path
+
+  void reset(const char *path);
+};
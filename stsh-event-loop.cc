@@ -0,0 +1,721 @@
+/**
+ * File: stsh-event-loop.cc
+ * ------------------------
+ * Presents the implementation of the STSHEventLoop class and
+ * the event loops deriving from it.
+ */
+
+#include "stsh-event-loop.h"
+#include "stsh-signal.h"
+#include "stsh-exception.h"
+#include "stsh-zygote.h"
+#include "stsh-event-ring.h"
+#include "stsh-uring.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <system_error>
+#include <chrono>
+#include <cerrno>
+#include <ctime>
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+using namespace std;
+
+/**
+ * Function: getCurrentTime
+ * ------------------------
+ * Returns the time on the CLOCK_MONOTONIC clock, in milliseconds.
+ */
+static uint64_t getCurrentTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Function: toTimespec
+ * --------------------
+ * Converts the provided timeout in milliseconds into ts, and returns its
+ * address, or returns NULL if the timeout is -1 (meaning forever), just as ppoll expects.
+ */
+static struct timespec *toTimespec(int timeout, struct timespec& ts) {
+  if (timeout < 0) return NULL;
+  ts.tv_sec = timeout / 1000;
+  ts.tv_nsec = (timeout % 1000) * 1000000L;
+  return &ts;
+}
+
+STSHEventLoop::STSHEventLoop(STSHJobList& joblist): joblist(joblist), deadlines(getCurrentTime()) {}
+
+void STSHEventLoop::setDeadline(STSHJob& job, double secs) {
+  uint64_t deadline = getCurrentTime() + uint64_t(secs * 1000);
+  job.setDeadline(deadline);
+  deadlines.add(deadline, uint64_t(job.getNum()) << 1);
+}
+
+int STSHEventLoop::getTimeout(int timeout) const {
+  long next = deadlines.getTimeout(getCurrentTime());
+  if (next < 0 || (timeout >= 0 && timeout <= next)) return timeout;
+  return int(next);
+}
+
+/**
+ * Timers are never cancelled: one that outlives its job finds the job gone, or
+ * finds some later job that took its number and whose own deadline, if it has one,
+ * isn't yet due, so each stage checks the job's deadline before it signals anything.
+ */
+void STSHEventLoop::expireDeadlines() {
+  if (deadlines.size() == 0) return;
+  uint64_t now = getCurrentTime();
+  vector<uint64_t> expired;
+  deadlines.advance(now, expired);
+  for (uint64_t value: expired) {
+    size_t num = value >> 1;
+    if (!joblist.containsJob(num)) continue; // it finished in time
+    STSHJob& job = joblist.getJob(num);
+    if (value & 1) {
+      if (job.hasDeadline() && job.getDeadline() + kKillGracePeriod <= now) job.signal(SIGKILL);
+    } else if (job.hasDeadline() && job.getDeadline() <= now) {
+      job.signal(SIGTERM);
+      job.signal(SIGCONT);
+      deadlines.add(now + kKillGracePeriod, value | 1);
+    }
+  }
+}
+
+void STSHEventLoop::recordChildEvent(pid_t pid, int status, const struct rusage& usage) {
+  STSHProcessState state;
+  if (WIFEXITED(status)) state = kTerminated;
+  if (WIFCONTINUED(status)) state = kRunning;
+  if (WIFSIGNALED(status)) state = kTerminated;
+  if (WIFSTOPPED(status)) state = kStopped;
+  recordChildEvent(pid, state, usage);
+}
+
+void STSHEventLoop::recordChildEvent(pid_t pid, STSHProcessState state, const struct rusage& usage) {
+  if (!joblist.containsProcess(pid)) return;  // e.g. the zygote itself
+  STSHJob& job = joblist.getJobWithProcess(pid);
+  STSHProcess& process = joblist.getProcess(pid);
+  if (state == kTerminated) process.setUsage(usage);
+  job.setProcessState(process, state);
+  joblist.synchronize(job);
+}
+
+/**
+ * wait4 only ever returns children that actually changed state, each of which
+ * is found through the job list's pid index, so a collection costs one system call
+ * per state change (plus the one that finds nothing left), however many jobs there
+ * are.  Processes are reaped by pid even if they have a pidfd; it's closed once
+ * they're marked terminated.
+ */
+void STSHEventLoop::collectChildEvents() {
+  pid_t pid;
+  int status;
+  struct rusage usage;
+  while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0) recordChildEvent(pid, status, usage);
+  while (readZygoteStatus(pid, status, usage)) recordChildEvent(pid, status, usage);
+}
+
+void STSHEventLoop::forwardSignal(int sig) {
+  if (!joblist.hasForegroundJob()) return;
+  joblist.getForegroundJob().signal(sig); // one killpg, however many processes
+}
+
+static const int kJobControlSignals[] = {SIGCHLD, SIGINT, SIGTSTP};
+
+/**
+ * Function: getJobControlSignals
+ * ------------------------------
+ * Returns the set of signals the event loops take over.
+ */
+static sigset_t getJobControlSignals() {
+  sigset_t mask;
+  sigemptyset(&mask);
+  for (int sig: kJobControlSignals) sigaddset(&mask, sig);
+  return mask;
+}
+
+/**
+ * Class: STSHSignalEventLoop
+ * --------------------------
+ * Receives every event through a signal handler, as soon as it arrives, unless
+ * the loop is locked, in which case the signal stays pending until it's unlocked (or
+ * until waitForForegroundJob or waitForInput waits).  The handlers never touch the job list: the
+ * SIGCHLD handler reaps every child with a state change into a lock-free ring of
+ * childEvent records, and the SIGINT and SIGTSTP handlers just make note of the
+ * signal.  The ring and the notes are then drained in normal context, as the loop waits
+ * or polls, and the job list is updated in one batch.
+ */
+class STSHSignalEventLoop: public STSHEventLoop {
+public:
+  STSHSignalEventLoop(STSHJobList& joblist);
+  const char *getName() const { return "signals"; }
+  void lock();
+  void unlock();
+  void waitForForegroundJob();
+  void waitForInput(int fd);
+  void poll();
+
+private:
+  struct childEvent {
+    pid_t pid;
+    int status;
+    struct rusage usage;
+    struct timespec collected; // when the handler reaped it
+  };
+
+  static const size_t kRingSize = 4096;
+  STSHEventRing<childEvent, kRingSize> events;
+  volatile sig_atomic_t interrupted; // set when SIGINT arrives, cleared once it's forwarded
+  volatile sig_atomic_t suspended;   // same, but for SIGTSTP
+  sigset_t unlocked; // the signal mask in place before the loop was locked
+
+  void queueChildEvents();
+  static STSHSignalEventLoop *instance; // for the signal handlers' benefit
+  static void handleSignal(int sig);
+};
+
+STSHSignalEventLoop *STSHSignalEventLoop::instance = NULL;
+
+STSHSignalEventLoop::STSHSignalEventLoop(STSHJobList& joblist): STSHEventLoop(joblist), interrupted(0), suspended(0) {
+  sigprocmask(SIG_SETMASK, NULL, &unlocked);
+  instance = this;
+  for (int sig: kJobControlSignals) installSignalHandler(sig, handleSignal);
+}
+
+void STSHSignalEventLoop::lock() {
+  sigset_t mask = getJobControlSignals();
+  sigprocmask(SIG_BLOCK, &mask, &unlocked);
+}
+
+void STSHSignalEventLoop::unlock() {
+  sigprocmask(SIG_SETMASK, &unlocked, NULL);
+}
+
+/**
+ * ppoll unblocks the signals only for as long as it waits, just as sigsuspend
+ * would, but can also give up in time for the next deadline.
+ */
+void STSHSignalEventLoop::waitForForegroundJob() {
+  poll();
+  while (joblist.hasForegroundJob()) {
+    struct timespec ts;
+    ppoll(NULL, 0, toTimespec(getTimeout(-1), ts), &unlocked);
+    poll();
+  }
+}
+
+void STSHSignalEventLoop::waitForInput(int fd) {
+  lock();
+  poll();
+  struct pollfd input = {fd, POLLIN, 0};
+  while (true) {
+    struct timespec ts;
+    int count = ppoll(&input, 1, toTimespec(getTimeout(-1), ts), &unlocked);
+    poll();
+    if (count > 0 || (count == -1 && errno != EINTR)) break;
+  }
+
+  unlock();
+}
+
+/**
+ * Method: queueChildEvents
+ * ------------------------
+ * Reaps every child with a state change, and collects every state change the
+ * zygote has forwarded, into the ring, stopping early if the ring fills up.
+ * Only ever called with SIGCHLD blocked (which it is while its handler runs), so
+ * the ring only ever has one producer.  Async-signal-safe and allocation-free.
+ */
+void STSHSignalEventLoop::queueChildEvents() {
+  childEvent event;
+  while (!events.full() && (event.pid = wait4(-1, &event.status, WNOHANG | WUNTRACED | WCONTINUED, &event.usage)) > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &event.collected);
+    events.push(event);
+  }
+
+  while (!events.full() && readZygoteStatus(event.pid, event.status, event.usage)) {
+    clock_gettime(CLOCK_MONOTONIC, &event.collected);
+    events.push(event);
+  }
+}
+
+/**
+ * Drains the ring and applies every state change in it.  If the ring filled up,
+ * some children may still be waiting to be reaped, so it's refilled (with SIGCHLD
+ * blocked, so the handler can't push at the same time) until nothing is left.
+ */
+void STSHSignalEventLoop::poll() {
+  sigset_t mask = getJobControlSignals(), existing;
+  sigprocmask(SIG_BLOCK, &mask, &existing);
+  childEvent event;
+  while (true) {
+    while (events.pop(event)) recordChildEvent(event.pid, event.status, event.usage);
+    queueChildEvents();
+    if (events.empty()) break;
+  }
+
+  if (interrupted) forwardSignal(SIGINT);
+  if (suspended) forwardSignal(SIGTSTP);
+  interrupted = suspended = 0;
+  expireDeadlines();
+  sigprocmask(SIG_SETMASK, &existing, NULL);
+}
+
+/**
+ * Method: handleSignal
+ * --------------------
+ * The one handler for all three signals.  It only calls async-signal-safe
+ * functions, never allocates, and restores errno before returning, since wait4
+ * and read can clobber it out from under whatever was interrupted.
+ */
+void STSHSignalEventLoop::handleSignal(int sig) {
+  int saved = errno;
+  switch (sig) {
+  case SIGCHLD: instance->queueChildEvents(); break;
+  case SIGINT: instance->interrupted = 1; break;
+  case SIGTSTP: instance->suspended = 1; break;
+  }
+
+  errno = saved;
+}
+
+/**
+ * Class: STSHEpollEventLoop
+ * -------------------------
+ * Keeps SIGCHLD, SIGINT, and SIGTSTP blocked for good, and receives them
+ * through a signalfd instead, which is watched by epoll along with whatever
+ * descriptor the shell is waiting to read.  Events are only ever processed
+ * while the shell is waiting, so locking is unnecessary.
+ */
+class STSHEpollEventLoop: public STSHEventLoop {
+public:
+  STSHEpollEventLoop(STSHJobList& joblist);
+  ~STSHEpollEventLoop();
+  const char *getName() const { return "epoll"; }
+  void waitForForegroundJob();
+  void waitForInput(int fd);
+  void poll() { dispatch(-1, 0); }
+
+private:
+  int epollfd;
+  int signalfd;
+  bool dispatch(int fd, int timeout = -1);
+  void processSignals();
+  static const int kMaxEvents = 8;
+};
+
+STSHEpollEventLoop::STSHEpollEventLoop(STSHJobList& joblist): STSHEventLoop(joblist) {
+  sigset_t mask = getJobControlSignals();
+  sigprocmask(SIG_BLOCK, &mask, NULL);
+  signalfd = ::signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  epollfd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = signalfd;
+  if (signalfd == -1 || epollfd == -1 || epoll_ctl(epollfd, EPOLL_CTL_ADD, signalfd, &event) == -1) {
+    if (signalfd != -1) close(signalfd);
+    if (epollfd != -1) close(epollfd);
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    throw STSHException("Could not set up the epoll event loop.");
+  }
+}
+
+STSHEpollEventLoop::~STSHEpollEventLoop() {
+  close(signalfd);
+  close(epollfd);
+}
+
+void STSHEpollEventLoop::waitForForegroundJob() {
+  while (joblist.hasForegroundJob()) dispatch(-1);
+}
+
+void STSHEpollEventLoop::waitForInput(int fd) {
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if (epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event) == -1) return; // e.g. a regular file, which is always readable
+  while (!dispatch(fd));
+  epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/**
+ * Method: dispatch
+ * ----------------
+ * Waits up to timeout milliseconds (forever, if it's -1), or until the next deadline,
+ * for something to happen, processes every signal that has arrived and every deadline
+ * that has passed, and returns true iff the provided descriptor became readable (or hung up).
+ */
+bool STSHEpollEventLoop::dispatch(int fd, int timeout) {
+  struct epoll_event events[kMaxEvents];
+  int count = epoll_wait(epollfd, events, kMaxEvents, getTimeout(timeout));
+  bool ready = false;
+  for (int i = 0; i < count; i++) {
+    if (events[i].data.fd == signalfd) processSignals();
+    else if (events[i].data.fd == fd) ready = true;
+  }
+
+  expireDeadlines();
+  return ready;
+}
+
+void STSHEpollEventLoop::processSignals() {
+  bool children = false;
+  struct signalfd_siginfo info;
+  while (read(signalfd, &info, sizeof(info)) == sizeof(info)) {
+    if (int(info.ssi_signo) == SIGCHLD) children = true; // one collection covers every SIGCHLD
+    else forwardSignal(info.ssi_signo);
+  }
+
+  if (children) collectChildEvents();
+}
+
+/**
+ * Class: STSHUringEventLoop
+ * -------------------------
+ * Keeps SIGCHLD, SIGINT, and SIGTSTP blocked for good, just as the epoll event
+ * loop does, but submits everything it waits on to an io_uring: a read of the
+ * signalfd, which is resubmitted every time it completes, a poll of each process's
+ * pidfd, submitted as soon as its job is watched, a poll of the zygote's status
+ * descriptor, and a poll of whatever descriptor the shell is waiting to read.  Every
+ * wake-up is a single io_uring_enter that both submits whatever was prepared since
+ * the last one and waits for the next completion.
+ *
+ * The terminal is polled rather than read, because readline insists on reading
+ * it itself.  Terminations are collected through the pidfds, one process at a time,
+ * so SIGCHLD only prompts a collection of stops and continues (waitid without
+ * WEXITED), rather than the wait4 drain the other loops use.  Processes without a pidfd
+ * can only be reaped by wait4, so once one is watched, SIGCHLD falls back to
+ * collectChildEvents for good, and the switch is reported on standard error.
+ */
+class STSHUringEventLoop: public STSHEventLoop {
+public:
+  STSHUringEventLoop(STSHJobList& joblist);
+  ~STSHUringEventLoop();
+  const char *getName() const { return "uring"; }
+  void waitForForegroundJob();
+  void waitForInput(int fd);
+  void poll() { dispatch(0); }
+  void watch(const STSHJob& job);
+
+private:
+  enum requestKind { kSignalRequest = 1, kInputRequest, kZygoteRequest, kProcessRequest };
+  static uint64_t tag(requestKind kind, uint32_t value = 0) { return uint64_t(kind) << 32 | value; }
+
+  static const unsigned kRingEntries = 1024;
+  static const size_t kMaxSignals = 8;
+  STSHUring ring;
+  int signalfd;
+  struct signalfd_siginfo signals[kMaxSignals]; // where the outstanding signalfd read lands
+  bool zygoteWatched;
+  bool inputReady;
+  bool fallback; // true once a process without a pidfd has been watched
+
+  void readSignals();
+  void watchZygote();
+  void dispatch(int timeout = -1);
+  void processSignals(int length);
+  void processTermination(pid_t pid);
+  void collectStateChanges();
+};
+
+STSHUringEventLoop::STSHUringEventLoop(STSHJobList& joblist): STSHEventLoop(joblist), ring(kRingEntries),
+                                                               zygoteWatched(false), inputReady(false), fallback(false) {
+  sigset_t mask = getJobControlSignals();
+  sigprocmask(SIG_BLOCK, &mask, NULL);
+  signalfd = ::signalfd(-1, &mask, SFD_CLOEXEC); // blocking, so the read waits inside the ring
+  if (signalfd == -1) {
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    throw STSHException("Could not set up the io_uring event loop.");
+  }
+
+  readSignals();
+}
+
+STSHUringEventLoop::~STSHUringEventLoop() {
+  close(signalfd);
+}
+
+void STSHUringEventLoop::readSignals() {
+  ring.prepareRead(signalfd, signals, sizeof(signals), tag(kSignalRequest));
+}
+
+/**
+ * Method: watchZygote
+ * -------------------
+ * Polls the zygote's status descriptor, provided the zygote has been started
+ * and the descriptor isn't already being polled.
+ */
+void STSHUringEventLoop::watchZygote() {
+  int fd = getZygoteStatusFD();
+  if (zygoteWatched || fd == -1) return;
+  ring.preparePoll(fd, POLLIN, tag(kZygoteRequest));
+  zygoteWatched = true;
+}
+
+void STSHUringEventLoop::watch(const STSHJob& job) {
+  for (const STSHProcess& process: job.getProcesses()) {
+    if (process.getDescriptor() == -1 && !fallback) {
+      cerr << "Process " << process.getID() << " has no pidfd, so the io_uring event loop"
+           << " collects terminations with wait4 from now on." << endl;
+      fallback = true;
+    } else if (process.getDescriptor() != -1) ring.preparePoll(process.getDescriptor(), POLLIN, tag(kProcessRequest, process.getID()));
+  }
+
+  watchZygote();
+}
+
+void STSHUringEventLoop::waitForForegroundJob() {
+  dispatch(0);
+  while (joblist.hasForegroundJob()) dispatch();
+}
+
+void STSHUringEventLoop::waitForInput(int fd) {
+  inputReady = false;
+  ring.preparePoll(fd, POLLIN, tag(kInputRequest));
+  while (!inputReady) dispatch();
+}
+
+/**
+ * Method: dispatch
+ * ----------------
+ * Submits everything prepared so far, waits up to timeout milliseconds (forever,
+ * if it's -1), or until the next deadline, for at least one completion, and processes
+ * every completion that has arrived and every deadline that has passed.
+ */
+void STSHUringEventLoop::dispatch(int timeout) {
+  ring.submit(getTimeout(timeout));
+  uint64_t tag;
+  int result;
+  while (ring.nextCompletion(tag, result)) {
+    switch (requestKind(tag >> 32)) {
+    case kSignalRequest:
+      processSignals(result);
+      readSignals();
+      break;
+    case kInputRequest:
+      inputReady = true; // even if the poll failed, so readline gets to see why
+      break;
+    case kZygoteRequest: {
+      pid_t pid;
+      int status;
+      struct rusage usage;
+      while (readZygoteStatus(pid, status, usage)) recordChildEvent(pid, status, usage);
+      zygoteWatched = false;
+      watchZygote();
+      break;
+    }
+    case kProcessRequest:
+      processTermination(pid_t(tag & 0xffffffff));
+      break;
+    }
+  }
+
+  expireDeadlines();
+}
+
+void STSHUringEventLoop::processSignals(int length) {
+  bool children = false;
+  for (int i = 0; i < length / int(sizeof(signals[0])); i++) {
+    if (int(signals[i].ssi_signo) == SIGCHLD) children = true; // one collection covers every SIGCHLD
+    else forwardSignal(signals[i].ssi_signo);
+  }
+
+  if (!children) return;
+  if (fallback) collectChildEvents();
+  else collectStateChanges();
+}
+
+/**
+ * Method: processTermination
+ * --------------------------
+ * Reaps the process with the provided pid, whose pidfd just polled as readable.
+ * It may already have been reaped some other way (by the zygote, or by
+ * collectChildEvents), in which case there's nothing left to do.
+ */
+void STSHUringEventLoop::processTermination(pid_t pid) {
+  if (!joblist.containsProcess(pid)) return;
+  STSHJob& job = joblist.getJobWithProcess(pid);
+  STSHProcess& process = joblist.getProcess(pid);
+  STSHProcessState state;
+  struct rusage usage;
+  if (!process.reap(state, usage)) return;
+  if (state == kTerminated) process.setUsage(usage);
+  job.setProcessState(process, state);
+  joblist.synchronize(job);
+}
+
+/**
+ * Method: collectStateChanges
+ * ---------------------------
+ * Collects every pending stop and continue of every child, leaving terminations
+ * to the pidfds, along with everything the zygote has forwarded.
+ */
+void STSHUringEventLoop::collectStateChanges() {
+  struct rusage none = {};
+  siginfo_t info;
+  while (true) {
+    info.si_pid = 0;
+    if (waitid(P_ALL, 0, &info, WSTOPPED | WCONTINUED | WNOHANG) == -1 || info.si_pid == 0) break;
+    recordChildEvent(info.si_pid, info.si_code == CLD_STOPPED ? kStopped : kRunning, none);
+  }
+
+  pid_t pid;
+  int status;
+  struct rusage usage;
+  while (readZygoteStatus(pid, status, usage)) recordChildEvent(pid, status, usage);
+}
+
+/**
+ * Class: STSHReaperEventLoop
+ * --------------------------
+ * Hands reaping to a dedicated thread, which blocks in waitid(P_ALL, ...) for
+ * the next state change of any child, records it in the job list under a mutex, and
+ * wakes the main thread through a condition variable.  SIGCHLD, SIGINT, and SIGTSTP
+ * stay blocked in every thread, and a second thread collects them with sigwait:
+ * SIGINT and SIGTSTP are forwarded to the foreground job, and SIGCHLD, which only
+ * matters for the zygote's forwarded statuses, prompts a drain of those.
+ *
+ * The job list changes whenever the mutex is free, so the main thread has to hold
+ * it (via lock) whenever it so much as looks at the job list.  Reaping throughput
+ * is independent of whatever the main thread is doing, be it waiting on the terminal
+ * or running a builtin.
+ */
+class STSHReaperEventLoop: public STSHEventLoop {
+public:
+  STSHReaperEventLoop(STSHJobList& joblist);
+  const char *getName() const { return "reaper"; }
+  void lock() { held.lock(); }
+  void unlock() { held.unlock(); }
+  void waitForForegroundJob();
+  void waitForInput(int fd);
+  void poll();
+  void watch(const STSHJob& job);
+
+private:
+  std::mutex m;
+  std::unique_lock<std::mutex> held;  // the main thread's hold on m
+  std::condition_variable changed;    // notified whenever the job list changes
+  std::condition_variable launched;   // notified whenever new children are watched
+  std::atomic<unsigned long> generation; // the number of jobs watched so far
+
+  void reap();
+  void receiveSignals();
+};
+
+STSHReaperEventLoop::STSHReaperEventLoop(STSHJobList& joblist): STSHEventLoop(joblist), held(m, std::defer_lock),
+                                                                 generation(0) {
+  sigset_t mask = getJobControlSignals();
+  pthread_sigmask(SIG_BLOCK, &mask, NULL); // before the threads start, so they inherit it
+  try {
+    std::thread(&STSHReaperEventLoop::reap, this).detach();
+    std::thread(&STSHReaperEventLoop::receiveSignals, this).detach();
+  } catch (const std::system_error& e) {
+    throw STSHException("Could not start the reaper threads.");
+  }
+}
+
+void STSHReaperEventLoop::waitForForegroundJob() {
+  expireDeadlines();
+  while (joblist.hasForegroundJob()) {
+    int timeout = getTimeout(-1);
+    if (timeout < 0) changed.wait(held);
+    else changed.wait_for(held, std::chrono::milliseconds(timeout));
+    expireDeadlines();
+  }
+}
+
+/**
+ * Events are processed by the other threads as they arrive, so all that's left
+ * to do while waiting for input is expiring deadlines.
+ */
+void STSHReaperEventLoop::waitForInput(int fd) {
+  struct pollfd input = {fd, POLLIN, 0};
+  while (true) {
+    int count = ::poll(&input, 1, getTimeout(-1));
+    poll();
+    if (count > 0 || (count == -1 && errno != EINTR)) break;
+  }
+}
+
+void STSHReaperEventLoop::poll() {
+  lock();
+  expireDeadlines();
+  unlock();
+}
+
+void STSHReaperEventLoop::watch(const STSHJob& job) {
+  generation++;
+  launched.notify_one();
+}
+
+/**
+ * Method: reap
+ * ------------
+ * The reaper thread's entry point.  waitid fails right away with ECHILD when
+ * there are no children at all, in which case the thread sleeps until a job
+ * is watched.  The raw system call is used for the rusage, just as it is in
+ * STSHProcess::reap.
+ */
+void STSHReaperEventLoop::reap() {
+  while (true) {
+    unsigned long seen = generation;
+    siginfo_t info;
+    struct rusage usage;
+    info.si_pid = 0;
+    if (syscall(SYS_waitid, P_ALL, 0, &info, WEXITED | WSTOPPED | WCONTINUED, &usage) == -1) {
+      if (errno != ECHILD) continue;
+      std::unique_lock<std::mutex> guard(m);
+      while (generation == seen) launched.wait(guard);
+      continue;
+    }
+
+    STSHProcessState state = kTerminated; // CLD_EXITED, CLD_KILLED, or CLD_DUMPED
+    if (info.si_code == CLD_STOPPED) state = kStopped;
+    if (info.si_code == CLD_CONTINUED) state = kRunning;
+    std::lock_guard<std::mutex> guard(m);
+    recordChildEvent(info.si_pid, state, usage);
+    changed.notify_all();
+  }
+}
+
+/**
+ * Method: receiveSignals
+ * ----------------------
+ * The signal thread's entry point.
+ */
+void STSHReaperEventLoop::receiveSignals() {
+  sigset_t mask = getJobControlSignals();
+  while (true) {
+    int sig;
+    if (sigwait(&mask, &sig) != 0) continue;
+    std::lock_guard<std::mutex> guard(m);
+    if (sig == SIGCHLD) {
+      pid_t pid;
+      int status;
+      struct rusage usage;
+      while (readZygoteStatus(pid, status, usage)) recordChildEvent(pid, status, usage);
+    } else {
+      forwardSignal(sig);
+    }
+
+    changed.notify_all();
+  }
+}
+
+STSHEventLoop *STSHEventLoop::create(const string& name, STSHJobList& joblist) {
+  if (name == "epoll") return new STSHEpollEventLoop(joblist);
+  if (name == "signals") return new STSHSignalEventLoop(joblist);
+  if (name == "uring") return new STSHUringEventLoop(joblist);
+  if (name == "reaper") return new STSHReaperEventLoop(joblist);
+  return NULL;
+}
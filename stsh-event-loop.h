@@ -0,0 +1,175 @@
+/**
+ * File: stsh-event-loop.h
+ * -----------------------
+ * Defines the STSHEventLoop class, which is responsible for noticing that
+ * something happened to one of stsh's children, or that the user typed ctrl-c or ctrl-z,
+ * and for updating the job list accordingly.  It's also what the shell blocks in
+ * whenever it waits, be it for the foreground job to finish or stop, or for the
+ * next line of terminal input.
+ *
+ * There are several implementations, selected once at startup via the
+ * STSH_EVENT_LOOP environment variable:
+ *
+ *   epoll:   the default.  SIGCHLD, SIGINT, and SIGTSTP stay blocked and are received
+ *            through a signalfd, which is watched by epoll alongside the terminal
+ *            while the shell waits for input.  Every job list update happens in
+ *            normal context, so nothing ever runs inside a signal handler.
+ *   signals: the classic approach, where signals are received by asynchronous
+ *            handlers, and the shell waits via ppoll, which unblocks them.  The handlers never touch
+ *            the job list: the SIGCHLD handler reaps into a lock-free ring (see
+ *            stsh-event-ring.h), which is drained whenever the shell waits or polls.
+ *   uring:   like epoll, except that everything is submitted to an io_uring (see
+ *            stsh-uring.h): a read of the signalfd, a poll of the terminal, and a poll of
+ *            every process's pidfd, so each wake-up costs a single io_uring_enter.
+ *            Terminations are collected one process at a time as their pidfds fire,
+ *            so SIGCHLD only prompts a collection of stops and continues.
+ *   reaper:  a dedicated thread reaps with a blocking waitid and updates the job list
+ *            under a mutex, which is what lock and unlock acquire and release, and
+ *            wakes the main thread through a condition variable.  Another thread
+ *            receives SIGINT and SIGTSTP via sigwait.
+ *
+ * Every event loop also enforces job deadlines, which are kept in a timer wheel (see
+ * stsh-timer-wheel.h) and expire whenever the loop waits or polls, without a signal
+ * or a timer of their own.
+ *
+ * Usage:
+ *
+ *    STSHEventLoop *loop = STSHEventLoop::create("epoll", joblist);
+ *    loop->lock();
+ *    launchPipeline(p, joblist, job);
+ *    loop->watch(job);
+ *    loop->waitForForegroundJob();
+ *    loop->unlock();
+ */
+
+#pragma once
+#include "stsh-job-list.h"
+#include "stsh-timer-wheel.h"
+#include <string>
+#include <sys/types.h>
+
+class STSHEventLoop {
+public:
+
+/**
+ * Static Method: create
+ * ---------------------
+ * Creates the named event loop on behalf of the provided job list, and has it
+ * take over SIGCHLD, SIGINT, and SIGTSTP.  Only one event loop should ever be
+ * created.  Returns NULL if there's no event loop by that name, and throws an STSHException
+ * if it couldn't be set up.
+ */
+  static STSHEventLoop *create(const std::string& name, STSHJobList& joblist);
+
+  virtual ~STSHEventLoop() {}
+
+/**
+ * Method: getName
+ * ---------------
+ * Returns the name the event loop was created under.
+ */
+  virtual const char *getName() const = 0;
+
+/**
+ * Methods: lock, unlock
+ * ---------------------
+ * Bracket any code that reads or modifies the job list while processes
+ * are live, so that no event can be processed in the middle of it.  Calls
+ * don't nest.  Under the reaper loop, events are processed on another thread
+ * at any moment, so even reading the job list requires the lock.
+ */
+  virtual void lock() {}
+  virtual void unlock() {}
+
+/**
+ * Method: waitForForegroundJob
+ * ----------------------------
+ * Processes events until the job list no longer has a foreground job.  Must be
+ * called while the event loop is locked.
+ */
+  virtual void waitForForegroundJob() = 0;
+
+/**
+ * Method: poll
+ * ------------
+ * Processes whatever events have already arrived, without waiting for more.
+ */
+  virtual void poll() = 0;
+
+/**
+ * Method: waitForInput
+ * --------------------
+ * Processes events until the provided descriptor can be read without blocking.
+ * Event loops that can't watch descriptors just poll and return right away.
+ */
+  virtual void waitForInput(int fd) { poll(); }
+
+/**
+ * Method: watch
+ * -------------
+ * Lets the event loop know about the processes of a freshly launched job,
+ * for event loops that watch each process individually.  Must be called while
+ * the event loop is locked.
+ */
+  virtual void watch(const STSHJob& job) {}
+
+/**
+ * Method: setDeadline
+ * -------------------
+ * Gives the provided job secs seconds to finish.  Once they're up, the job's
+ * process group is sent SIGTERM (and SIGCONT, in case it's stopped), followed by
+ * SIGKILL kKillGracePeriod milliseconds later if it still hasn't finished.  Setting
+ * another deadline replaces the first one.  Must be called while the event loop is
+ * locked.
+ */
+  void setDeadline(STSHJob& job, double secs);
+  static const uint64_t kKillGracePeriod = 2000;
+
+protected:
+  STSHEventLoop(STSHJobList& joblist);
+
+/**
+ * Method: getTimeout
+ * ------------------
+ * Returns the provided wait timeout in milliseconds (-1 meaning forever),
+ * shortened if need be so that the wait ends in time for the next deadline.
+ */
+  int getTimeout(int timeout) const;
+
+/**
+ * Method: expireDeadlines
+ * -----------------------
+ * Signals every job whose deadline (or grace period) has passed.  Event loops
+ * call this every time they wait or poll.
+ */
+  void expireDeadlines();
+
+/**
+ * Method: collectChildEvents
+ * --------------------------
+ * Collects every pending state change of every child, including those the
+ * zygote forwarded on behalf of its children, and records them in the job list.
+ */
+  void collectChildEvents();
+
+/**
+ * Method: recordChildEvent
+ * ------------------------
+ * Records the state change described by the provided wait4 status (or the
+ * provided state) and resource usage against the process with the provided pid,
+ * if the job list knows about it.
+ */
+  void recordChildEvent(pid_t pid, int status, const struct rusage& usage);
+  void recordChildEvent(pid_t pid, STSHProcessState state, const struct rusage& usage);
+
+/**
+ * Method: forwardSignal
+ * ---------------------
+ * Forwards the provided signal (SIGINT or SIGTSTP, presumably) to the
+ * foreground job's process group, if there is a foreground job.
+ */
+  void forwardSignal(int sig);
+
+  STSHJobList& joblist;
+  STSHTimerWheel deadlines; // each timer's value is a job number, shifted left, plus 1 once it's been sent SIGTERM
+};
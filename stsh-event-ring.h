@@ -0,0 +1,78 @@
+/**
+ * File: stsh-event-ring.h
+ * -----------------------
+ * Defines and inline-implements the STSHEventRing class template, a fixed-size,
+ * lock-free queue with a single producer and a single consumer.  Neither push nor pop
+ * allocates, locks, or makes a system call, so the producer can be a signal handler
+ * interrupting the consumer, which is exactly how the signals event loop uses it:
+ * its SIGCHLD handler pushes every state change it reaps, and the main loop later pops
+ * them and applies them to the job list in one batch.
+ */
+
+#pragma once
+#include <cstddef>
+#include <atomic>
+
+template <typename T, size_t N>
+class STSHEventRing {
+  static_assert(N > 0 && (N & (N - 1)) == 0, "STSHEventRing capacity must be a power of two");
+
+public:
+  STSHEventRing(): head(0), tail(0) {}
+
+/**
+ * Method: full
+ * ------------
+ * Returns true iff there's no room for another record.  Only meaningful
+ * to the producer, since only the consumer can make room.
+ */
+  bool full() const {
+    return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_acquire) == N;
+  }
+
+/**
+ * Method: empty
+ * -------------
+ * Returns true iff there are no records to pop.  Only meaningful to the
+ * consumer, since only the producer can add records.
+ */
+  bool empty() const {
+    return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire);
+  }
+
+/**
+ * Method: push
+ * ------------
+ * Appends a copy of the provided record, and returns true, unless the ring
+ * is full, in which case it returns false.  Must only be called by the producer.
+ */
+  bool push(const T& record) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) == N) return false;
+    records[t & (N - 1)] = record;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+/**
+ * Method: pop
+ * -----------
+ * Removes the oldest record and places it in record, and returns true, unless
+ * the ring is empty, in which case it returns false.  Must only be called by the consumer.
+ */
+  bool pop(T& record) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return false;
+    record = records[h & (N - 1)];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T records[N];
+  std::atomic<size_t> head; // the number of records ever popped, only written by the consumer
+  std::atomic<size_t> tail; // the number of records ever pushed, only written by the producer
+
+  STSHEventRing(const STSHEventRing&) = delete;
+  STSHEventRing& operator=(const STSHEventRing&) = delete;
+};
@@ -0,0 +1,63 @@
+/**
+ * File: stsh-exec-cache.cc
+ * ------------------------
+ * Presents the implementation of the STSHExecCache class.
+ */
+
+#include "stsh-exec-cache.h"
+#include <iomanip>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+using namespace std;
+
+int STSHExecCache::lookup(const string& name, const string& path) {
+  if (name.find('/') != string::npos) return -1;
+  auto found = index.find(name);
+  if (found != index.end()) {
+    auto it = found->second;
+    if (it->path == path) {
+      hits++;
+      entries.splice(entries.begin(), entries, it);
+      return it->fd;
+    }
+
+    invalidations++;
+    evict(it);
+  }
+
+  misses++;
+  int fd = open(path.c_str(), O_PATH | O_CLOEXEC);
+  if (fd == -1) return -1;
+  if (entries.size() >= capacity) evict(prev(entries.end()));
+  entry e = {name, path, fd};
+  entries.push_front(e);
+  index[name] = entries.begin();
+  return fd;
+}
+
+void STSHExecCache::clear() {
+  for (const entry& e: entries) close(e.fd);
+  entries.clear();
+  index.clear();
+}
+
+void STSHExecCache::evict(list<entry>::iterator it) {
+  close(it->fd);
+  index.erase(it->name);
+  entries.erase(it);
+}
+
+ostream& operator<<(ostream& os, const STSHExecCache& cache) {
+  size_t lookups = cache.hits + cache.misses;
+  os << "exec cache: " << cache.hits << " hits, " << cache.misses << " misses, "
+     << cache.invalidations << " invalidations";
+  if (lookups > 0) {
+    ostringstream rate; // so os keeps its own formatting flags
+    rate << fixed << setprecision(1) << 100.0 * cache.hits / lookups;
+    os << " (" << rate.str() << "% hit rate)";
+  }
+
+  os << ", " << cache.entries.size() << "/" << cache.capacity << " descriptors cached" << endl;
+  return os;
+}
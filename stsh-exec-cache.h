@@ -0,0 +1,82 @@
+/**
+ * File: stsh-exec-cache.h
+ * -----------------------
+ * Defines the STSHExecCache class, which holds O_PATH descriptors for the
+ * executables behind the most recently launched commands, so that launching
+ * one of them again can exec the descriptor directly (via execveat and AT_EMPTY_PATH)
+ * instead of having the kernel resolve its path and check every directory along the way.
+ *
+ * The cache is keyed by command name, holds at most a fixed number of descriptors, and
+ * evicts the least recently used one when it needs room for another.  A hit costs no
+ * system calls at all.  An entry is discarded whenever the command resolves to a different
+ * path, and the whole cache is meant to be cleared whenever the STSHCommandHash forgets
+ * what it knows, since that's when a directory in PATH was modified (e.g. because an
+ * executable in it was reinstalled).  Only commands found through PATH are cached, since
+ * nothing watches the directories holding anything named by path.
+ */
+
+#pragma once
+#include <cstddef>
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <iostream>
+
+class STSHExecCache {
+
+/**
+ * Function: operator<<
+ * Usage: cout << cache;
+ * ---------------------
+ * Reports the number of hits, misses, and invalidations, the hit rate,
+ * and how many descriptors are cached.
+ */
+  friend std::ostream& operator<<(std::ostream& os, const STSHExecCache& cache);
+
+public:
+
+/**
+ * Constructor: STSHExecCache
+ * --------------------------
+ * Constructs an empty cache that holds at most the provided number of descriptors.
+ */
+  STSHExecCache(size_t capacity = kDefaultCapacity): capacity(capacity), hits(0), misses(0), invalidations(0) {}
+  ~STSHExecCache() { clear(); }
+
+/**
+ * Method: lookup
+ * --------------
+ * Returns an O_PATH, close-on-exec descriptor for the executable at path, which is
+ * what the named command resolved to, opening and caching one if necessary.  Returns
+ * -1 if the file can't be opened, or if the name includes a slash, in which case it
+ * should be exec'ed by path.  The descriptor is owned by the cache, and remains valid
+ * until the next call to lookup or clear.
+ */
+  int lookup(const std::string& name, const std::string& path);
+
+/**
+ * Method: clear
+ * -------------
+ * Closes and forgets every cached descriptor.  The statistics are left alone.
+ */
+  void clear();
+
+  static const size_t kDefaultCapacity = 64;
+
+private:
+  struct entry {
+    std::string name;
+    std::string path;
+    int fd;
+  };
+
+  size_t capacity;
+  std::list<entry> entries; // most recently used first
+  std::unordered_map<std::string, std::list<entry>::iterator> index;
+  size_t hits, misses, invalidations;
+
+  void evict(std::list<entry>::iterator it);
+
+  STSHExecCache(const STSHExecCache&) = delete;
+  STSHExecCache& operator=(const STSHExecCache&) = delete;
+};
@@ -0,0 +1,287 @@
+/**
+ * File: stsh-inprocess.cc
+ * -----------------------
+ * Presents the implementation of the in-process commands.
+ */
+
+#include "stsh-inprocess.h"
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <cctype>
+#include <iostream>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <unistd.h>
+#include <signal.h>
+using namespace std;
+
+static const char *const kInProcessCommands[] = {"true", "false", ":", "echo", "printf"};
+static const size_t kNumInProcessCommands = sizeof(kInProcessCommands)/sizeof(kInProcessCommands[0]);
+
+bool isInProcessCommand(const command& cmd) {
+  for (size_t i = 0; i < kNumInProcessCommands; i++) {
+    if (strcmp(cmd.command, kInProcessCommands[i]) == 0) return true;
+  }
+
+  return false;
+}
+
+/**
+ * Function: appendEscape
+ * ----------------------
+ * Appends the character denoted by the backslash escape starting at str[i]
+ * (just past the backslash) to out, and advances i past it.  Returns false if
+ * the escape is \c, which means no further output should be produced.
+ */
+static bool appendEscape(const string& str, size_t& i, string& out) {
+  if (i == str.size()) {
+    out += '\\';
+    return true;
+  }
+
+  char ch = str[i++];
+  switch (ch) {
+  case 'a': out += '\a'; break;
+  case 'b': out += '\b'; break;
+  case 'c': return false;
+  case 'e': out += '\033'; break;
+  case 'f': out += '\f'; break;
+  case 'n': out += '\n'; break;
+  case 'r': out += '\r'; break;
+  case 't': out += '\t'; break;
+  case 'v': out += '\v'; break;
+  case '\\': out += '\\'; break;
+  case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': {
+    int value = ch - '0';
+    for (size_t digits = 1; digits < 3 && i < str.size() && str[i] >= '0' && str[i] <= '7'; digits++)
+      value = value * 8 + str[i++] - '0';
+    out += char(value);
+    break;
+  }
+  default: out += '\\'; out += ch; break;
+  }
+
+  return true;
+}
+
+/**
+ * Function: renderEcho
+ * --------------------
+ * Renders what echo would print for the provided arguments.  Leading -n, -e,
+ * and -E flags (and combinations like -ne) are honored; anything else starting
+ * with a dash is printed.
+ */
+static string renderEcho(const vector<string>& args) {
+  bool newline = true, escapes = false;
+  size_t i = 0;
+  for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-' &&
+         args[i].find_first_not_of("neE", 1) == string::npos; i++) {
+    for (char flag: args[i].substr(1)) {
+      if (flag == 'n') newline = false;
+      else escapes = flag == 'e';
+    }
+  }
+
+  string out;
+  for (size_t first = i; i < args.size(); i++) {
+    if (i > first) out += ' ';
+    if (!escapes) {
+      out += args[i];
+      continue;
+    }
+
+    for (size_t j = 0; j < args[i].size();) {
+      char ch = args[i][j++];
+      if (ch != '\\') out += ch;
+      else if (!appendEscape(args[i], j, out)) return out;
+    }
+  }
+
+  if (newline) out += '\n';
+  return out;
+}
+
+/**
+ * Function: takeNumber
+ * --------------------
+ * Consumes the next argument, if there is one, as the value of a * in a
+ * conversion's width or precision, and appends it to spec.
+ */
+static void takeNumber(const vector<string>& args, size_t& next, string& spec) {
+  long value = next < args.size() ? strtol(args[next++].c_str(), NULL, 0) : 0;
+  spec += to_string(value);
+}
+
+/**
+ * Function: renderPrintf
+ * ----------------------
+ * Renders what printf would print for the provided format and arguments into out.  Conversions
+ * are handed to snprintf one at a time, after the argument has been converted to the type
+ * the conversion expects, and missing arguments are treated as empty strings or zeroes.
+ * A * width or precision takes its value from the next argument, length modifiers are
+ * ignored, and %b prints its argument with its backslash escapes expanded.  Returns false,
+ * with a description of the problem in error, upon reaching a conversion it doesn't know,
+ * in which case out holds everything rendered before it.
+ */
+static bool renderPrintf(const string& format, const vector<string>& args, string& out, string& error) {
+  size_t next = 0;
+  do {
+    size_t consumed = next;
+    for (size_t i = 0; i < format.size();) {
+      char ch = format[i++];
+      if (ch == '\\') {
+        if (!appendEscape(format, i, out)) return true;
+        continue;
+      }
+
+      if (ch != '%') {
+        out += ch;
+        continue;
+      }
+
+      if (i < format.size() && format[i] == '%') {
+        out += '%';
+        i++;
+        continue;
+      }
+
+      string spec = "%";
+      while (i < format.size() && strchr("-+ #0", format[i]) != NULL) spec += format[i++];
+      if (i < format.size() && format[i] == '*') {
+        takeNumber(args, next, spec);
+        i++;
+      } else {
+        while (i < format.size() && isdigit(format[i])) spec += format[i++];
+      }
+
+      if (i < format.size() && format[i] == '.') {
+        spec += format[i++];
+        if (i < format.size() && format[i] == '*') {
+          takeNumber(args, next, spec);
+          i++;
+        } else {
+          while (i < format.size() && isdigit(format[i])) spec += format[i++];
+        }
+      }
+
+      while (i < format.size() && strchr("hlLqjzt", format[i]) != NULL) i++;
+      if (i == format.size()) {
+        error = "printf: " + spec + ": missing conversion";
+        return false;
+      }
+
+      char conversion = format[i++];
+      string arg = next < args.size() ? args[next] : "";
+      char buffer[1024];
+      switch (conversion) {
+      case 'd': case 'i':
+        snprintf(buffer, sizeof(buffer), (spec + "lld").c_str(), strtoll(arg.c_str(), NULL, 0));
+        break;
+      case 'u': case 'o': case 'x': case 'X':
+        snprintf(buffer, sizeof(buffer), (spec + "ll" + conversion).c_str(), strtoull(arg.c_str(), NULL, 0));
+        break;
+      case 'f': case 'e': case 'E': case 'g': case 'G':
+        snprintf(buffer, sizeof(buffer), (spec + conversion).c_str(), strtod(arg.c_str(), NULL));
+        break;
+      case 'c':
+        snprintf(buffer, sizeof(buffer), (spec + "c").c_str(), arg.empty() ? '\0' : arg[0]);
+        break;
+      case 's':
+        snprintf(buffer, sizeof(buffer), (spec + "s").c_str(), arg.c_str());
+        break;
+      case 'b': {
+        string expanded;
+        bool more = true;
+        for (size_t j = 0; j < arg.size() && more;) {
+          char ch = arg[j++];
+          if (ch != '\\') expanded += ch;
+          else more = appendEscape(arg, j, expanded);
+        }
+
+        snprintf(buffer, sizeof(buffer), (spec + "s").c_str(), expanded.c_str());
+        if (!more) {
+          out += buffer;
+          return true; // \c in the argument ends all output
+        }
+
+        break;
+      }
+      default:
+        error = "printf: " + spec + conversion + ": invalid conversion";
+        return false;
+      }
+
+      if (next < args.size()) next++;
+      out += buffer;
+    }
+
+    if (next == consumed) break; // the format has no conversions, so it's never reused
+  } while (next < args.size());
+
+  return true;
+}
+
+/**
+ * Function: writeAll
+ * ------------------
+ * Writes all of the provided text to fd, or as much of it as can be written
+ * before an error other than EINTR.
+ */
+static void writeAll(int fd, const string& text) {
+  for (size_t written = 0; written < text.size();) {
+    ssize_t count = write(fd, text.data() + written, text.size() - written);
+    if (count == -1 && errno == EINTR) continue;
+    if (count <= 0) return;
+    written += count;
+  }
+}
+
+/**
+ * Function: runCommand
+ * --------------------
+ * Runs the named in-process command with the provided arguments.
+ */
+static void runCommand(const string& name, const vector<string>& args, int outfd) {
+  if (name == "echo") {
+    writeAll(outfd, renderEcho(args));
+  } else if (name == "printf") {
+    if (args.empty()) return;
+    string out, error;
+    bool rendered = renderPrintf(args[0], vector<string>(args.begin() + 1, args.end()), out, error);
+    writeAll(outfd, out);
+    if (!rendered) writeAll(STDERR_FILENO, error + "\n");
+  } // true, false, and : produce nothing
+}
+
+static vector<string> getArguments(const command& cmd) {
+  vector<string> args;
+  for (size_t i = 0; cmd.tokens[i] != NULL; i++) args.push_back(cmd.tokens[i]);
+  return args;
+}
+
+void runInProcessCommand(const command& cmd, int outfd) {
+  if (outfd == STDOUT_FILENO) cout.flush(); // so nothing already printed comes out after
+  runCommand(cmd.command, getArguments(cmd), outfd);
+}
+
+void startInProcessCommand(const command& cmd, int outfd, int donefd) {
+  sigset_t all, existing;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &existing); // the thread inherits the mask
+  try {
+    thread([outfd, donefd](const string& name, const vector<string>& args) {
+      runCommand(name, args, outfd);
+      close(outfd);
+      if (donefd != -1) close(donefd);
+    }, string(cmd.command), getArguments(cmd)).detach();
+  } catch (const system_error& e) {
+    cerr << cmd.command << ": Could not start a thread." << endl;
+    close(outfd);
+    if (donefd != -1) close(donefd);
+  }
+
+  pthread_sigmask(SIG_SETMASK, &existing, NULL);
+}
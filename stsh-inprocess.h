@@ -0,0 +1,47 @@
+/**
+ * File: stsh-inprocess.h
+ * ----------------------
+ * Defines the in-process commands: true, false, :, echo, and printf.  They're
+ * trivial enough that stsh implements them itself instead of paying for a fork, an
+ * exec, and a reap each time one is run.  They behave like their /bin counterparts
+ * (echo understands -n, -e, and -E, and printf reuses its format until every argument
+ * is consumed), except that they never read standard input, and stsh doesn't keep
+ * exit statuses, so true and false do nothing at all.
+ *
+ * A command line made up of a single in-process command is run directly by
+ * handleBuiltin.  Within a longer pipeline, every in-process command, including a trailing
+ * one, runs on a thread of its own, so it can block on a pipe without blocking the shell.
+ *
+ * printf understands the flags, widths, and precisions (including *) snprintf does, ignores
+ * length modifiers, and supports %b; any other conversion is reported as an error.
+ */
+
+#pragma once
+#include "stsh-parser/stsh-parse.h" // for struct command
+
+/**
+ * Function: isInProcessCommand
+ * ----------------------------
+ * Returns true iff the provided command is one stsh runs in-process.
+ */
+bool isInProcessCommand(const command& cmd);
+
+/**
+ * Function: runInProcessCommand
+ * -----------------------------
+ * Runs the provided in-process command to completion, writing its output to outfd.
+ */
+void runInProcessCommand(const command& cmd, int outfd);
+
+/**
+ * Function: startInProcessCommand
+ * -------------------------------
+ * Runs the provided in-process command on a detached thread that writes its output
+ * to outfd and then closes it, so the caller gives up outfd (even if no thread
+ * could be started, in which case the problem is reported and the command produces nothing).  The thread blocks every
+ * signal, so signal handlers only ever run on the main thread, and a write to a pipe
+ * whose reader has gone away fails with EPIPE rather than raising SIGPIPE in the shell.
+ * The caller also gives up donefd, if it isn't -1, which the thread closes once it's
+ * done, so that the other end of a pipe polls as hung up when the command has finished.
+ */
+void startInProcessCommand(const command& cmd, int outfd, int donefd = -1);
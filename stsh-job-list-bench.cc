@@ -0,0 +1,220 @@
+/**
+ * File: stsh-job-list-bench.cc
+ * ----------------------------
+ * Measures how each of the job list's operations scales with the number of
+ * processes it holds, reporting the average time and the average number of heap
+ * allocations per operation.  For each size (10, 1k, 100k, and 1M processes, or just
+ * --size), it fills a fresh job list with synthetic processes (their pids are made up,
+ * and nothing is ever launched or signaled), --width to a job, and times:
+ *
+ *   addJob:            adding every job, still empty
+ *   addProcess:        adding every process to its job
+ *   getJobWithProcess: what every event loop does for each child wait4 or a pidfd reports,
+ *                      or slay does given a pid (containsProcess, getJobWithProcess, and
+ *                      getProcess), for random pids
+ *   synchronize:       stopping every process and then continuing it again, in random order,
+ *                      synchronizing its job and taking any notification each time
+ *   operator<<:        listing the whole job list, as jobs does, per job listed
+ *   churn:             running a short-lived job of --width processes, from addJob through
+ *                      to the synchronize that erases it, alongside everything else
+ *   erase:             terminating every process, in random order, and synchronizing its
+ *                      job (and taking its notification), until the job list is empty
+ *
+ * e.g.
+ *
+ *   ./stsh-job-list-bench --size 100000 --width 10
+ *
+ * malloc, calloc, and realloc are interposed on to count allocations, which
+ * covers every operator new as well.
+ */
+#include "stsh-job-list.h"
+#include "stsh-exception.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstdlib>
+#include <getopt.h>
+using namespace std;
+
+static size_t allocations = 0;
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size) {
+  allocations++;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  allocations++;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+  allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+static const size_t kSizes[] = {10, 1000, 100000, 1000000};
+static const size_t kMinimumOperations = 100000; // so the smallest job lists are timed over enough work
+
+static const int kIncorrectUsage = 1;
+static void printUsage(const string& message, const string& executable) {
+  cerr << "Error: " << message << endl;
+  cerr << "Usage: ./" << executable << " [--size n] [--width n]" << endl;
+  exit(kIncorrectUsage);
+}
+
+static void extractArguments(int argc, char *argv[], size_t& size, size_t& width) {
+  struct option options[] = {
+    {"size", required_argument, NULL, 's'},
+    {"width", required_argument, NULL, 'w'},
+    {NULL, 0, NULL, 0},
+  };
+
+  while (true) {
+    int ch = getopt_long(argc, argv, "s:w:", options, NULL);
+    if (ch == -1) break;
+    switch (ch) {
+    case 's':
+      size = atoi(optarg);
+      if (size == 0) printUsage("Size must be positive.", argv[0]);
+      break;
+    case 'w':
+      width = atoi(optarg);
+      break;
+    default:
+      printUsage("Unrecognized flag.", argv[0]);
+    }
+  }
+
+  argc -= optind;
+  if (argc > 0) printUsage("Too many arguments.", argv[0]);
+  if (width == 0) printUsage("Width must be positive.", argv[0]);
+}
+
+/**
+ * Class: measurement
+ * ------------------
+ * Notes the time and the allocation count when it's constructed, and prints
+ * a row of the report, averaged over the provided number of operations, when
+ * report is called.
+ */
+class measurement {
+public:
+  measurement(): start(chrono::steady_clock::now()), allocated(allocations) {}
+  void report(size_t size, const string& name, size_t count) const {
+    double nsecs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+    size_t allocs = allocations - allocated;
+    cout << setw(9) << size << "   " << setw(18) << left << name << right << fixed << setprecision(1)
+         << setw(12) << nsecs / count << setprecision(2) << setw(12) << double(allocs) / count << endl;
+  }
+
+private:
+  chrono::steady_clock::time_point start;
+  size_t allocated;
+};
+
+/**
+ * Function: changeState
+ * ---------------------
+ * Moves the process with the provided pid to the provided state, synchronizes
+ * its job, and takes whatever notification that queued, just as the shell
+ * would before its next prompt.
+ */
+static void changeState(STSHJobList& joblist, pid_t pid, STSHProcessState state) {
+  STSHJob& job = joblist.getJobWithProcess(pid);
+  job.setProcessState(joblist.getProcess(pid), state);
+  joblist.synchronize(job);
+  joblist.takeNotifications();
+}
+
+/**
+ * Function: benchmarkSize
+ * -----------------------
+ * Runs every operation against a job list of the provided number of processes,
+ * width to a job, and prints a row for each.
+ */
+static void benchmarkSize(size_t size, size_t width, const command& cmd) {
+  size_t jobs = (size + width - 1) / width;
+  vector<pid_t> pids;
+  for (size_t i = 0; i < size; i++) pids.push_back(pid_t(i + 2)); // pid 1 is never a child
+  mt19937 random(17);
+
+  STSHJobList joblist;
+  vector<size_t> nums;
+  nums.reserve(jobs);
+  measurement adding;
+  for (size_t i = 0; i < jobs; i++) nums.push_back(joblist.addJob(kBackground).getNum());
+  adding.report(size, "addJob", jobs);
+
+  measurement filling;
+  for (size_t i = 0; i < size; i++) joblist.addProcess(joblist.getJob(nums[i / width]), STSHProcess(pids[i]), cmd);
+  filling.report(size, "addProcess", size);
+
+  size_t lookups = max(size, kMinimumOperations), found = 0;
+  uniform_int_distribution<size_t> pick(0, size - 1);
+  vector<pid_t> targets;
+  for (size_t i = 0; i < lookups; i++) targets.push_back(pids[pick(random)]);
+  measurement looking;
+  for (pid_t pid: targets) {
+    if (!joblist.containsProcess(pid)) continue;
+    const STSHJob& job = joblist.getJobWithProcess(pid);
+    found += job.getNum() > 0 && joblist.getProcess(pid).getID() == pid;
+  }
+  looking.report(size, "getJobWithProcess", lookups);
+  if (found != lookups) throw STSHException("Some processes went missing from the job list.");
+
+  shuffle(pids.begin(), pids.end(), random);
+  measurement synchronizing;
+  for (pid_t pid: pids) changeState(joblist, pid, kStopped);
+  for (pid_t pid: pids) changeState(joblist, pid, kRunning);
+  synchronizing.report(size, "synchronize", 2 * size);
+
+  size_t listings = max<size_t>(1, kMinimumOperations / jobs);
+  ostringstream listing;
+  measurement printing;
+  for (size_t i = 0; i < listings; i++) {
+    listing.str("");
+    listing << joblist;
+  }
+  printing.report(size, "operator<<", listings * jobs);
+
+  size_t churn = max(jobs, kMinimumOperations / width);
+  measurement churning;
+  for (size_t i = 0; i < churn; i++) {
+    STSHJob& job = joblist.addJob(kForeground); // so nothing's announced when it's erased
+    for (size_t j = 0; j < width; j++) joblist.addProcess(job, STSHProcess(pid_t(size + 2 + j)), cmd);
+    for (STSHProcess& process: job.getProcesses()) job.setProcessState(process, kTerminated);
+    joblist.synchronize(job);
+  }
+  churning.report(size, "churn", churn);
+
+  measurement erasing;
+  for (pid_t pid: pids) changeState(joblist, pid, kTerminated);
+  erasing.report(size, "erase", size);
+  if (joblist.size() != 0) throw STSHException("Some jobs outlived their processes.");
+}
+
+int main(int argc, char *argv[]) {
+  size_t size = 0, width = 1;
+  extractArguments(argc, argv, size, width);
+  pipeline p("./spin 600");
+  cout << "Job lists of synthetic processes, " << width << " to a job." << endl;
+  cout << setw(9) << "processes" << "   " << setw(18) << left << "operation" << right
+       << setw(12) << "ns/op" << setw(12) << "allocs/op" << endl;
+  if (size != 0) {
+    benchmarkSize(size, width, p.commands[0]);
+  } else {
+    for (size_t size: kSizes) benchmarkSize(size, width, p.commands[0]);
+  }
+
+  return 0;
+}
@@ -7,31 +7,49 @@
 #include "stsh-job-list.h"
 #include "stsh-exception.h"
 #include <iostream>
-#include <iomanip>
-#include <sstream>
+#include <algorithm>
 using namespace std;
 
 STSHJob STSHJobList::njob; // njob stands for no-job
+STSHProcess STSHJobList::nprocess;
 
 STSHJob& STSHJobList::addJob(const STSHJobState& state) {
-  jobs[next] = STSHJob(next, state);
-  return jobs[next++];
+  size_t num;
+  if (available.empty()) {
+    jobs.emplace_back(); // a deque never moves the jobs already in it
+    num = jobs.size();
+  } else {
+    num = available.top();
+    available.pop();
+  }
+
+  STSHJob& job = jobs[num - 1];
+  job.reset(num, state);
+  count++;
+  if (num > last) last = num;
+  if (state == kForeground) foreground = num;
+  return job;
+}
+
+void STSHJobList::addProcess(STSHJob& job, const STSHProcess& process, const command& cmd) {
+  location loc = {job.getNum(), job.getProcesses().size()};
+  job.addProcess(process, cmd);
+  pids[process.getID()] = loc;
+}
+
+void STSHJobList::setState(STSHJob& job, STSHJobState state) {
+  job.setState(state);
+  if (state == kForeground) foreground = job.getNum();
+  else if (foreground == job.getNum()) foreground = 0;
 }
 
 bool STSHJobList::hasForegroundJob() const {
-  const STSHJob& job = getForegroundJob();
-  return &job != &njob;
+  return foreground != 0;
 }
 
 STSHJob& STSHJobList::getForegroundJob() {
-  for (pair<const size_t, STSHJob>& p: jobs) {
-    STSHJob& job = p.second;
-    if (job.getState() == kForeground) {
-      return job;
-    }
-  }
-
-  return njob;
+  if (foreground == 0) return njob;
+  return jobs[foreground - 1];
 }
 
 const STSHJob& STSHJobList::getForegroundJob() const { 
@@ -39,12 +57,21 @@ const STSHJob& STSHJobList::getForegroundJob() const {
 }
 
 bool STSHJobList::containsJob(size_t num) const {
-  return jobs.find(num) != jobs.cend();
+  return num > 0 && num <= last && jobs[num - 1].getNum() != 0;
+}
+
+vector<size_t> STSHJobList::getJobNumbers(size_t first, size_t last) const {
+  vector<size_t> nums;
+  for (size_t num = max<size_t>(first, 1); num <= min(last, this->last); num++) {
+    if (containsJob(num)) nums.push_back(num);
+  }
+
+  return nums;
 }
 
 STSHJob& STSHJobList::getJob(size_t num) {
   if (!containsJob(num)) return njob;
-  return jobs[num];
+  return jobs[num - 1];
 }
 
 const STSHJob& STSHJobList::getJob(size_t num) const {
@@ -52,50 +79,105 @@ const STSHJob& STSHJobList::getJob(size_t num) const {
 }
 
 bool STSHJobList::containsProcess(pid_t pid) const {
-  const STSHJob& job = getJobWithProcess(pid);
-  return &job != &njob;
+  return pids.find(pid) != pids.cend();
 }
 
 STSHJob& STSHJobList::getJobWithProcess(pid_t pid) {
-  for (pair<const size_t, STSHJob>& p: jobs) {
-    STSHJob& job = p.second;    
-    if (job.containsProcess(pid)) {
-      return job;
-    }
-  }
-  
-  return njob;
+  auto found = pids.find(pid);
+  if (found == pids.end()) return njob;
+  return jobs[found->second.num - 1];
 }
 
 const STSHJob& STSHJobList::getJobWithProcess(pid_t pid) const {
   return const_cast<STSHJobList *>(this)->getJobWithProcess(pid);
 }
 
+STSHProcess& STSHJobList::getProcess(pid_t pid) {
+  auto found = pids.find(pid);
+  if (found == pids.end()) return nprocess;
+  return jobs[found->second.num - 1].getProcesses()[found->second.slot];
+}
+
+const STSHProcess& STSHJobList::getProcess(pid_t pid) const {
+  return const_cast<STSHJobList *>(this)->getProcess(pid);
+}
+
 void STSHJobList::synchronize(STSHJob& job) {
-  const vector<STSHProcess>& processes = job.getProcesses();
-  bool somethingIsRunning = false;
-  for (const STSHProcess& process: processes) {
-    if (process.getState() == kRunning) {
-      somethingIsRunning = true;
-      break;
-    }
-  }
-  
+  bool somethingIsRunning = job.countProcesses(kRunning) > 0;
+  bool somethingIsStopped = job.countProcesses(kStopped) > 0;
+  bool wasForeground = job.getState() == kForeground;
   if (!somethingIsRunning) {
-    job.setState(kBackground); // make sure it's not categorized as foreground
+    setState(job, kBackground); // make sure it's not categorized as foreground
   }
   
-  for (const STSHProcess& process: processes) {
-    if (process.getState() != kTerminated) {
-      return;
-    }
+  if (job.countProcesses(kTerminated) < job.getProcesses().size()) {
+    if (!somethingIsStopped || somethingIsRunning) stopped.erase(job.getNum());
+    else if (stopped.insert(job.getNum()).second) notify(job);
+    return;
   }
   
-  jobs.erase(job.getNum());
+  bool announced = !wasForeground && !job.getProcesses().empty();
+  if (announced) notify(job); // nobody's waiting on it, so say it's done
+  stopped.erase(job.getNum());
+  remove(job, announced);
+}
+
+/**
+ * Method: remove
+ * --------------
+ * Erases the provided job, and unindexes each of its processes, unless
+ * its pid has since been taken over by a process in some other job.  The
+ * job's slot is kept for the next job to take its number, though not until
+ * the job's notification has been taken, if it has one, so that no notification
+ * ever names a number that's since been handed to another job.
+ */
+void STSHJobList::remove(STSHJob& job, bool announced) {
+  size_t num = job.getNum();
+  for (const STSHProcess& process: job.getProcesses()) {
+    auto found = pids.find(process.getID());
+    if (found != pids.end() && found->second.num == num) pids.erase(found);
+  }
+
+  job.reset(0, kBackground);
+  if (announced) retiring.push_back(num);
+  else available.push(num);
+  count--;
+  while (last > 0 && jobs[last - 1].getNum() == 0) last--;
+}
+
+/**
+ * Method: notify
+ * --------------
+ * Queues up a notification describing the provided job's current state.
+ */
+void STSHJobList::notify(const STSHJob& job) {
+  job.append(notifications, true);
+  notifications += '\n';
+}
+
+string STSHJobList::takeNotifications() {
+  string taken;
+  taken.swap(notifications);
+  for (size_t num: retiring) available.push(num);
+  retiring.clear();
+  return taken;
+}
+
+void STSHJobList::print(ostream& os, bool verbose) const {
+  string lines;
+  append(lines, verbose);
+  os << lines;
+}
+
+void STSHJobList::append(string& out, bool verbose) const {
+  for (size_t num = 1; num <= last; num++) {
+    if (!containsJob(num)) continue;
+    jobs[num - 1].append(out, verbose);
+    out += '\n';
+  }
 }
 
 ostream& operator<<(ostream& os, const STSHJobList& joblist) {
-  for (const pair<size_t, STSHJob>& p: joblist.jobs) 
-    os << p.second << endl;
+  joblist.print(os, false);
   return os;
 }
@@ -5,12 +5,12 @@
  * If you want to add a new process to a job list, you might 
  * do so this way:
  * 
- *    static void addToJobList(STSHJobList& jobList, const vector<pair<pid_t, string>>& children) {
+ *    static void addToJobList(STSHJobList& jobList, const vector<pair<pid_t, command>>& children) {
  *      STSHJob& job = jobList.addJob(kBackground); //
- *      for (const pair<string, pid_t>& child: children) {
+ *      for (const pair<pid_t, command>& child: children) {
  *        pid_t pid = child.first;
- *        const string& command = child.second;
- *        job.addProcess(STSHProcess(pid, command)); // third argument defaults to kRunning     
+ *        const command& cmd = child.second;
+ *        jobList.addProcess(job, STSHProcess(pid), cmd); // STSHProcess's second argument defaults to kRunning
  *      }
  *    
  *      cout << jobList;
@@ -21,11 +21,20 @@
  *    static void updateJobList(STSHJobList& jobList, pid_t pid, STSHProcess state) {
  *      if (!jobList.containsProcess()) return;
  *      STSHJob& job = STSHJob.getJobWithProcess(pid);
- *      assert(job.containsProcess(pid));
- *      STSHProcess& process = job.getProcess(pid_t pid);
- *      process.setState(state);
+ *      STSHProcess& process = jobList.getProcess(pid);
+ *      job.setProcessState(process, state);
  *      jobList.synchronize(job);
  *    }
+ *
+ * Every process should be added through the job list, rather than through
+ * STSHJob::addProcess directly, so that it's indexed by pid: containsProcess,
+ * getJobWithProcess, and getProcess find it without scanning every job.
+ *
+ * Jobs are pooled: job n lives in the nth slot of a deque, and a slot is
+ * recycled, along with the storage it set aside for processes, once its job is
+ * gone.  Each new job takes the lowest job number not in use, as zsh does, so
+ * the job table stays dense and job numbers stay small.  A finished job's number
+ * is only reused once its notification has been taken.
  */
 
 #pragma once
@@ -34,7 +43,12 @@
 #include "stsh-process.h"
 #include <cstddef>
 #include <string>
-#include <map>
+#include <set>
+#include <deque>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <unordered_map>
 #include <iostream>
 #include <sys/types.h>
 
@@ -60,11 +74,31 @@ public:
  */
   STSHJob& addJob(const STSHJobState& state);
 
+/**
+ * Method: addProcess
+ * ------------------
+ * Appends the provided process, which runs the provided command, to the provided
+ * job, which must be in the job list (see STSHJob::addProcess), and indexes it by pid.  A pid that's still indexed on behalf of
+ * some long-reaped process is simply taken over by the new one.
+ */
+  void addProcess(STSHJob& job, const STSHProcess& process, const command& cmd);
+
+/**
+ * Method: setState
+ * ----------------
+ * Sets the state of the provided job, which must be in the job list.  A job
+ * should only be moved to the foreground this way, rather than through
+ * STSHJob::setState directly, since the job list keeps track of which job
+ * is in the foreground.
+ */
+  void setState(STSHJob& job, STSHJobState state);
+
 /**
  * Method: hasForegroundJob
  * ------------------------
  * Returns true if and only if the receiving STSHJobList has
- * a foreground job (of course, there can be at most one.)
+ * a foreground job (of course, there can be at most one.)  It runs in
+ * constant time, however many jobs there are.
  */
   bool hasForegroundJob() const;
 
@@ -87,6 +121,21 @@ public:
  */  
   bool containsJob(size_t num) const;
 
+/**
+ * Method: size
+ * ------------
+ * Returns the number of jobs in the job list.
+ */
+  size_t size() const { return count; }
+
+/**
+ * Method: getJobNumbers
+ * ---------------------
+ * Returns the number of every job in the job list numbered first through
+ * last, in increasing order.
+ */
+  std::vector<size_t> getJobNumbers(size_t first, size_t last) const;
+
 /**
  * Method: getJob
  * --------------
@@ -116,6 +165,16 @@ public:
   STSHJob& getJobWithProcess(pid_t pid);
   const STSHJob& getJobWithProcess(pid_t pid) const;
 
+/**
+ * Method: getProcess
+ * ------------------
+ * Returns a reference to the process with the specified pid, wherever it is
+ * in the job list.  As with getJobWithProcess, calls should be guarded by calls
+ * to containsProcess.
+ */
+  STSHProcess& getProcess(pid_t pid);
+  const STSHProcess& getProcess(pid_t pid) const;
+
 /**
  * Method: synchronize
  * -------------------
@@ -124,12 +183,55 @@ public:
  * the entire job around it to be consistent with those changes
  * (e.g. if all processes have terminated, the surrounding job is terminated, or
  * if none of the processes are running, then the job can't be considered
- * a foreground job).
+ * a foreground job).  A notification is queued (see takeNotifications) whenever
+ * a job that isn't in the foreground terminates, and whenever a job stops.
  */  
   void synchronize(STSHJob& job);
+
+/**
+ * Method: takeNotifications
+ * -------------------------
+ * Returns every notification queued since the last call, already formatted as
+ * jobs -v would print the jobs involved, and clears the queue.  Returns the empty
+ * string if nothing has happened.  The shell prints these just before each prompt,
+ * all at once, however many jobs finished in between.
+ */
+  std::string takeNotifications();
+
+/**
+ * Method: print
+ * -------------
+ * Inserts the same serialization operator<< does into the provided ostream,
+ * except that each process is printed verbosely (see STSHProcess::print) if verbose is true.
+ */
+  void print(std::ostream& os, bool verbose) const;
+
+/**
+ * Method: append
+ * --------------
+ * Appends the same serialization print does to the provided string, without
+ * going through a stream.
+ */
+  void append(std::string& out, bool verbose) const;
   
 private:
-  size_t next = 1;
-  std::map<size_t, STSHJob> jobs; // maps work, because we want to publish in order of job number
+  std::deque<STSHJob> jobs;       // job n is jobs[n - 1], and free slots have job number 0
+  std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> available; // free job numbers, lowest first
+  std::vector<size_t> retiring;   // free job numbers still named by queued notifications
+  size_t count = 0;               // the number of jobs in use
+  size_t last = 0;                // the highest job number in use, or 0 if there isn't one
+  size_t foreground = 0;          // the number of the foreground job, or 0 if there isn't one
+  std::set<size_t> stopped;       // jobs whose stop has already been announced
+  std::string notifications;
+
+  struct location {
+    size_t num;  // the number of the job
+    size_t slot; // the index of the process within the job
+  };
+  std::unordered_map<pid_t, location> pids; // every process in the job list, by pid
+
+  void notify(const STSHJob& job);
+  void remove(STSHJob& job, bool announced);
   static STSHJob njob;
+  static STSHProcess nprocess;
 };
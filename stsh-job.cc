@@ -5,8 +5,9 @@
  */
 
 #include "stsh-job.h"
-#include <iomanip> // for setw
-#include <sstream> // for ostringstream
+#include <cstdio>  // for snprintf
+#include <cerrno>  // for errno
+#include <signal.h> // for killpg
 using namespace std;
 
 STSHProcess STSHJob::nprocess;
@@ -30,16 +31,81 @@ const STSHProcess& STSHJob::getProcess(pid_t pid) const {
   return const_cast<STSHJob *>(this)->getProcess(pid);
 }
 
-ostream& operator<<(ostream& os, const STSHJob& job) {
-  ostringstream oss;
-  oss << "[" << job.num << "]";
-  os << setw(oss.str().size()) << oss.str() << " ";
-  if (job.processes.empty()) return os << "(job is empty, devoid of processes)";
-  os << job.processes[0];
-  for (size_t i = 1; i < job.processes.size(); i++) {
-    os << " |" << endl;
-    os << setw(oss.str().size()) << " " << " " << job.processes[i];
+void STSHJob::addProcess(const STSHProcess& process, const command& cmd) {
+  size_t offset = commandLines.size();
+  commandLines += cmd.command;
+  for (char * const *tokenp = &cmd.tokens[0]; *tokenp != NULL; tokenp++) {
+    commandLines += ' ';
+    commandLines += *tokenp;
+  }
+
+  processes.push_back(process);
+  processes.back().setCommandLine(&commandLines, offset, commandLines.size() - offset);
+  counts[process.getState()]++;
+}
+
+void STSHJob::reset(size_t num, STSHJobState state) {
+  this->num = num;
+  this->state = state;
+  processes.clear(); // both keep their capacity
+  commandLines.clear();
+  for (size_t& count: counts) count = 0;
+  deadline = 0;
+}
+
+void STSHJob::setProcessState(STSHProcess& process, STSHProcessState state) {
+  counts[process.getState()]--;
+  counts[state]++;
+  process.setState(state);
+}
+
+int STSHJob::signal(int sig) const {
+  pid_t pgid = getGroupID();
+  if (pgid == 0) { // killpg(0, sig) would signal stsh's own process group
+    errno = ESRCH;
+    return -1;
   }
 
+  return killpg(pgid, sig);
+}
+
+void STSHJob::print(ostream& os, bool verbose) const {
+  string lines;
+  append(lines, verbose);
+  os << lines;
+}
+
+void STSHJob::append(string& out, bool verbose) const {
+  char prefix[32];
+  int width = snprintf(prefix, sizeof(prefix), "[%zu] ", num);
+  out.append(prefix, width);
+  if (processes.empty()) {
+    out += "(job is empty, devoid of processes)";
+    return;
+  }
+
+  processes[0].append(out, verbose);
+  for (size_t i = 1; i < processes.size(); i++) {
+    out += " |\n";
+    out.append(width, ' ');
+    processes[i].append(out, verbose);
+  }
+}
+
+void STSHJob::appendJSON(string& out) const {
+  const char *summary = isRunning() ? "Running" : isStopped() ? "Stopped" : "Terminated";
+  char buffer[128];
+  out.append(buffer, snprintf(buffer, sizeof(buffer), "{\"job\":%zu,\"pgid\":%d,\"state\":\"%s\",\"foreground\":%s,\"processes\":[",
+                              num, int(getGroupID()), summary, state == kForeground ? "true" : "false"));
+  for (size_t i = 0; i < processes.size(); i++) {
+    if (i > 0) out += ',';
+    processes[i].appendJSON(out);
+  }
+
+  out += "]}";
+}
+
+ostream& operator<<(ostream& os, const STSHJob& job) {
+  job.print(os, false);
   return os;
 }
@@ -5,24 +5,31 @@
  * with an stsh job.  The following code snippet illustrates 
  * how an individual STSHJob is manipulated.
  * 
- *     static STSHJob createJob(size_t num, const vector<STSHProcess>& processes) {
- *       STSHJob job(num, kBackground);
- *       for (const STSHProcess& process: processes) job.addProcess(process);
+ *     static void fillJob(STSHJob& job, const vector<pair<pid_t, command>>& children) {
+ *       for (const pair<pid_t, command>& child: children) job.addProcess(STSHProcess(child.first), child.second);
  *     }
  *
  * In practice, STSHJobs are constructed by the JobList, which
  * maintains a list of all STSHJobs, as with this:
  *
- *     static size_t addJob(JobList& joblist, const vector<STSHProcess>& processes, STSHJobState state) {
+ *     static size_t addJob(JobList& joblist, const vector<pair<pid_t, command>>& children, STSHJobState state) {
  *       STSHJob& job = joblist.addJob(state);
- *       for (const STSHProcess& process) job.addProcess(process);
+ *       for (const pair<pid_t, command>& child: children) joblist.addProcess(job, STSHProcess(child.first), child.second);
  *       return job.getNum(); // surface the job number the job was assigned
  *     }
+ *
+ * A job owns the text of its processes' command lines, all in one string that only
+ * ever grows while the job is being launched, and each of its processes just refers
+ * to its own stretch of it.  Since the processes refer back to the job, jobs
+ * can't be copied.
  */
 
 #pragma once
 #include "stsh-process.h"
+#include "stsh-parser/stsh-parse.h" // for struct command
 #include <cstddef>  // for size_t
+#include <cstdint>  // for uint64_t
+#include <string>   // for string
 #include <vector>   // for vector
 #include <iostream> // for ostream
 
@@ -50,6 +57,31 @@ class STSHJob {
   
 public:
 
+/**
+ * Method: print
+ * -------------
+ * Inserts the same serialization operator<< does into the provided ostream,
+ * except that each process is printed verbosely (see STSHProcess::print) if verbose is true.
+ */
+  void print(std::ostream& os, bool verbose) const;
+
+/**
+ * Method: append
+ * --------------
+ * Appends the same serialization print does to the provided string, without
+ * going through a stream.
+ */
+  void append(std::string& out, bool verbose) const;
+
+/**
+ * Method: appendJSON
+ * ------------------
+ * Appends a JSON object describing the job to the provided string: its number,
+ * process group, overall state (see isRunning and isStopped), whether it's in
+ * the foreground, and each of its processes (see STSHProcess::appendJSON).
+ */
+  void appendJSON(std::string& out) const;
+
 /**
  * Constructor: STSHJob
  * --------------------
@@ -64,6 +96,17 @@ public:
  * Constructs an instance of STSHJob with the specified job number and state.
  */
   STSHJob(size_t num, STSHJobState state) : num(num), state(state) {}
+  STSHJob(const STSHJob& other) = delete;
+  STSHJob& operator=(const STSHJob& other) = delete;
+
+/**
+ * Method: reset
+ * -------------
+ * Reinitializes the job with the provided job number and state, as if it had
+ * just been constructed, except that the storage already set aside for its
+ * processes is kept for whatever processes are added next.
+ */
+  void reset(size_t num, STSHJobState state);
 
 /**
  * Method: STSHJob
@@ -75,9 +118,11 @@ public:
 /**
  * Method: addProcess
  * ------------------
- * Appends the provided STSHProcess to be sequence of previously appended processes.
+ * Appends the provided STSHProcess to be sequence of previously appended processes,
+ * and appends the provided command (its name and arguments, separated by spaces) to
+ * the job's command lines, where the process's own copy refers to it.
  */
-  void addProcess(const STSHProcess& process) { processes.push_back(process); }
+  void addProcess(const STSHProcess& process, const command& cmd);
 
 /**
  * Method: getProcesses
@@ -88,6 +133,31 @@ public:
   std::vector<STSHProcess>& getProcesses() { return processes; }
   const std::vector<STSHProcess>& getProcesses() const { return processes; }
 
+/**
+ * Method: setProcessState
+ * -----------------------
+ * Sets the state of the provided process, which must be one of the job's own,
+ * and keeps the job's count of processes in each state current.  Once a process
+ * has been added to a job, its state should only ever be changed this way.
+ */
+  void setProcessState(STSHProcess& process, STSHProcessState state);
+
+/**
+ * Method: countProcesses
+ * ----------------------
+ * Returns how many of the job's processes are in the provided state, in constant time.
+ */
+  size_t countProcesses(STSHProcessState state) const { return counts[state]; }
+
+/**
+ * Methods: isRunning, isStopped
+ * -----------------------------
+ * Return whether any of the job's processes are running, and whether the job
+ * is stopped, which is to say that none are running but some are stopped.
+ */
+  bool isRunning() const { return counts[kRunning] > 0; }
+  bool isStopped() const { return counts[kRunning] == 0 && counts[kStopped] > 0; }
+
 /**
  * Method: containsProcess
  * -----------------------
@@ -115,7 +185,8 @@ public:
 /**
  * Method: setState
  * ----------------
- * Sets the job state (which must be either kForeground or kBackground).
+ * Sets the job state (which must be either kForeground or kBackground).  The state
+ * of a job in a job list should be set through STSHJobList::setState instead.
  */
   void setState(STSHJobState state) { this->state = state; }
 
@@ -127,9 +198,31 @@ public:
  */
   pid_t getGroupID() const { return processes.empty() ? 0 : processes[0].getID(); }
 
+/**
+ * Method: signal
+ * --------------
+ * Sends the provided signal to every process in the job at once, via killpg
+ * on its process group.  Returns 0 on success and -1 on failure, just as killpg
+ * does, and fails with ESRCH if the job is empty.
+ */
+  int signal(int sig) const;
+
+/**
+ * Methods: hasDeadline, getDeadline, setDeadline
+ * ----------------------------------------------
+ * Manage the time (in milliseconds, on the CLOCK_MONOTONIC clock) by which the job
+ * must finish, if it has one (see STSHEventLoop::setDeadline, which enforces it).
+ */
+  bool hasDeadline() const { return deadline != 0; }
+  uint64_t getDeadline() const { return deadline; }
+  void setDeadline(uint64_t deadline) { this->deadline = deadline; }
+
 private:
   size_t num;
   std::vector<STSHProcess> processes;
+  std::string commandLines; // every process's command line, back to back
+  size_t counts[kTerminated + 1] = {}; // the number of processes in each STSHProcessState
   STSHJobState state;
+  uint64_t deadline = 0;
   static STSHProcess nprocess;
 };
@@ -0,0 +1,147 @@
+/**
+ * File: stsh-launch-bench.cc
+ * --------------------------
+ * Measures how many jobs per second each of stsh's launch engines
+ * can create and reap.  The shell's own footprint can be inflated with
+ * --heap so the cost of duplicating a large address space shows up, and
+ * the command can be repeated into a pipeline of any --width, e.g.
+ *
+ *   ./stsh-launch-bench --jobs 1 --width 1000 --command ./conduit < /dev/null
+ */
+#include "stsh-launch.h"
+#include "stsh-exception.h"
+#include "stsh-zygote.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <poll.h>
+#include <sys/wait.h>
+using namespace std;
+
+static const char *const kEngines[] = {"fork", "spawn", "clone", "zygote"};
+static const size_t kNumEngines = sizeof(kEngines)/sizeof(kEngines[0]);
+
+static const int kIncorrectUsage = 1;
+static void printUsage(const string& message, const string& executable) {
+  cerr << "Error: " << message << endl;
+  cerr << "Usage: ./" << executable << " [--jobs n] [--heap mb] [--engine name] [--command line] [--width n]" << endl;
+  exit(kIncorrectUsage);
+}
+
+static void extractArguments(int argc, char *argv[], size_t& jobs, size_t& heap,
+                             string& engine, string& line, size_t& width) {
+  struct option options[] = {
+    {"jobs", required_argument, NULL, 'j'},
+    {"heap", required_argument, NULL, 'h'},
+    {"engine", required_argument, NULL, 'e'},
+    {"command", required_argument, NULL, 'c'},
+    {"width", required_argument, NULL, 'w'},
+    {NULL, 0, NULL, 0},
+  };
+
+  while (true) {
+    int ch = getopt_long(argc, argv, "j:h:e:c:w:", options, NULL);
+    if (ch == -1) break;
+    switch (ch) {
+    case 'j':
+      jobs = atoi(optarg);
+      break;
+    case 'h':
+      heap = atoi(optarg);
+      break;
+    case 'e':
+      engine = optarg;
+      break;
+    case 'c':
+      line = optarg;
+      break;
+    case 'w':
+      width = atoi(optarg);
+      break;
+    default:
+      printUsage("Unrecognized flag.", argv[0]);
+    }
+  }
+
+  argc -= optind;
+  if (argc > 0) printUsage("Too many arguments.", argv[0]);
+  if (width == 0) printUsage("Width must be positive.", argv[0]);
+}
+
+/**
+ * Function: waitForJob
+ * --------------------
+ * Waits for every process in the provided job to exit, and marks it terminated.  Processes launched by the zygote
+ * aren't children of this one, so their exits arrive as forwarded statuses instead.
+ */
+static void waitForJob(STSHJob& job) {
+  set<pid_t> remaining;
+  for (const STSHProcess& process: job.getProcesses()) {
+    if (waitpid(process.getID(), NULL, 0) == -1) remaining.insert(process.getID());
+  }
+
+  while (!remaining.empty()) {
+    pid_t pid;
+    int status;
+    struct rusage usage;
+    while (readZygoteStatus(pid, status, usage)) {
+      if (WIFEXITED(status) || WIFSIGNALED(status)) remaining.erase(pid);
+    }
+
+    struct pollfd fd = {getZygoteStatusFD(), POLLIN, 0};
+    if (!remaining.empty()) poll(&fd, 1, -1);
+  }
+
+  for (STSHProcess& process: job.getProcesses()) job.setProcessState(process, kTerminated); // closes its pidfd
+}
+
+/**
+ * Function: runJobs
+ * -----------------
+ * Launches the pipeline the specified number of times, one job at a time,
+ * waiting for every process of a job before launching the next one, and
+ * returns the number of seconds it all took.
+ */
+static double runJobs(const pipeline& p, size_t jobs) {
+  STSHJobList joblist;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (size_t i = 0; i < jobs; i++) {
+    STSHJob& job = joblist.addJob(kForeground);
+    launchPipeline(p, joblist, job);
+    waitForJob(job);
+    joblist.synchronize(job); // every process has terminated, so this erases the job
+  }
+
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  size_t jobs = 1000, heap = 0, width = 1;
+  string engine, line = "true";
+  extractArguments(argc, argv, jobs, heap, engine, line, width);
+  raiseDescriptorLimit(); // every process holds a pidfd
+  string command = line;
+  for (size_t i = 1; i < width; i++) line += " | " + command;
+  if (!engine.empty() && !setLaunchEngine(engine)) printUsage("Unknown launch engine.", argv[0]);
+  if (engine.empty() || engine == "zygote") startZygote(); // before the heap grows, as stsh would
+  vector<char> ballast(heap << 20, 1); // touched, so every page is resident
+  pipeline p(line);
+  if (width == 1) cout << "Launching " << jobs << " jobs of \"" << line << "\"";
+  else cout << "Launching " << jobs << " jobs of " << width << " \"" << command << "\"s";
+  cout << " with " << heap << "MB of extra heap." << endl;
+  for (size_t i = 0; i < kNumEngines; i++) {
+    if (!engine.empty() && engine != kEngines[i]) continue;
+    setLaunchEngine(kEngines[i]);
+    double secs = runJobs(p, jobs);
+    cout << setw(6) << kEngines[i] << ": " << fixed << setprecision(3) << secs << "s, "
+         << setprecision(0) << jobs / secs << " jobs/sec" << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,395 @@
+/**
+ * File: stsh-launch.cc
+ * --------------------
+ * Presents the implementation of launchPipeline and the
+ * launch engines it delegates to.
+ */
+
+#include "stsh-launch.h"
+#include "stsh-exception.h"
+#include "stsh-command-hash.h"
+#include "stsh-exec-cache.h"
+#include "stsh-zygote.h"
+#include "stsh-inprocess.h"
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+using namespace std;
+
+extern char **environ;
+
+static const char *const kLaunchEngineNames[] = {"fork", "spawn", "clone", "zygote"};
+static const size_t kNumLaunchEngines = sizeof(kLaunchEngineNames)/sizeof(kLaunchEngineNames[0]);
+static STSHLaunchEngine engine = kForkEngine;
+static STSHCommandHash commandHash;
+static STSHExecCache execCache;
+
+bool setLaunchEngine(const string& name) {
+  for (size_t i = 0; i < kNumLaunchEngines; i++) {
+    if (name == kLaunchEngineNames[i]) {
+      if (i == kZygoteEngine) startZygote();
+      engine = STSHLaunchEngine(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+STSHLaunchEngine getLaunchEngine() {
+  return engine;
+}
+
+const char *getLaunchEngineName() {
+  return kLaunchEngineNames[engine];
+}
+
+STSHCommandHash& getCommandHash() {
+  return commandHash;
+}
+
+STSHExecCache& getExecCache() {
+  return execCache;
+}
+
+size_t raiseDescriptorLimit() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == -1) return 0;
+  if (limit.rlim_cur != limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) == -1) getrlimit(RLIMIT_NOFILE, &limit);
+  }
+
+  return limit.rlim_cur;
+}
+
+static const int kShellSignals[] = {SIGQUIT, SIGTTIN, SIGTTOU, SIGCHLD, SIGINT, SIGTSTP};
+void resetChildSignals() {
+  for (int sig: kShellSignals) signal(sig, SIG_DFL);
+  sigset_t empty;
+  sigemptyset(&empty);
+  sigprocmask(SIG_SETMASK, &empty, NULL);
+}
+
+/**
+ * Function: markDescriptorsCloseOnExec
+ * ------------------------------------
+ * Marks every descriptor above standard error close-on-exec with a single
+ * close_range call, so a child never leaks descriptors the shell happened to
+ * inherit without the flag.  The shell's own descriptors already have it.
+ */
+static void markDescriptorsCloseOnExec() {
+#ifdef SYS_close_range
+  syscall(SYS_close_range, 3, ~0U, CLOSE_RANGE_CLOEXEC);
+#endif
+}
+
+/**
+ * Function: execute
+ * -----------------
+ * Execs the executable at path, through execfd (an O_PATH descriptor for it) if
+ * there is one.  Scripts can't be run through a close-on-exec descriptor, since their
+ * interpreter couldn't open it, so those fall back to path.  Only returns if
+ * the exec failed.
+ */
+static void execute(const char *path, int execfd, char *argv[]) {
+#ifdef SYS_execveat
+  if (execfd != -1) {
+    syscall(SYS_execveat, execfd, "", argv, environ, AT_EMPTY_PATH);
+    if (errno != ENOENT) return;
+  }
+#endif
+  execve(path, argv, environ);
+}
+
+static const int kExecFailed = 127;
+
+/**
+ * Function: forkProcess
+ * ---------------------
+ * Forks a full copy of the shell, and has the child join the process group, install
+ * infd and outfd as its standard input and output (-1 means leave it alone),
+ * and exec the executable at path (through execfd, if it isn't -1).
+ *
+ * The child reports a failed exec by writing its errno to a close-on-exec status pipe,
+ * which the shell reads right away: end-of-file means the exec went through, since
+ * that's when the child's end was closed.  A child whose exec failed is reaped on the spot,
+ * and -1 is returned with errno set accordingly, so no shell code ever runs in the child.
+ */
+static pid_t forkProcess(const char *path, int execfd, char *argv[], pid_t pgid, int infd, int outfd) {
+  int status[2];
+  if (pipe2(status, O_CLOEXEC) == -1) return -1;
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(status[0]);
+    setpgid(0, pgid);
+    resetChildSignals();
+    if (infd != -1) dup2(infd, STDIN_FILENO);
+    if (outfd != -1) dup2(outfd, STDOUT_FILENO);
+    markDescriptorsCloseOnExec();
+    execute(path, execfd, argv);
+    int error = errno;
+    write(status[1], &error, sizeof(error));
+    _exit(kExecFailed);
+  }
+
+  int error = errno;
+  close(status[1]);
+  if (pid != -1) {
+    ssize_t count;
+    do {
+      count = read(status[0], &error, sizeof(error));
+    } while (count == -1 && errno == EINTR);
+    if (count == sizeof(error)) {
+      waitpid(pid, NULL, 0);
+      pid = -1;
+    }
+  }
+
+  close(status[0]);
+  if (pid == -1) errno = error;
+  return pid;
+}
+
+/**
+ * Function: spawnProcess
+ * ----------------------
+ * Expresses everything forkProcess's child does as posix_spawn attributes and file
+ * actions, and lets posix_spawn create the process without duplicating the
+ * shell's address space.  Returns -1, with errno set, if the process couldn't be created.
+ */
+static pid_t spawnProcess(const char *path, char *argv[], pid_t pgid, int infd, int outfd) {
+  posix_spawnattr_t attr;
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+  posix_spawnattr_setpgroup(&attr, pgid);
+  sigset_t mask;
+  sigemptyset(&mask);
+  posix_spawnattr_setsigmask(&attr, &mask);
+  sigaddset(&mask, SIGTTIN);
+  sigaddset(&mask, SIGTTOU);
+  posix_spawnattr_setsigdefault(&attr, &mask);
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (infd != -1) posix_spawn_file_actions_adddup2(&actions, infd, STDIN_FILENO);
+  if (outfd != -1) posix_spawn_file_actions_adddup2(&actions, outfd, STDOUT_FILENO);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+  posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+#endif
+
+  pid_t pid;
+  int err = posix_spawn(&pid, path, &actions, &attr, argv, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  if (err == 0) return pid;
+  errno = err;
+  return -1;
+}
+
+/**
+ * Type: trampoline
+ * ----------------
+ * Everything the clone engine's child needs, packaged up so it
+ * can be passed through clone to runTrampoline.  Because the child shares
+ * the shell's memory, it reports a failed execve by writing the error here.
+ */
+struct trampoline {
+  const char *path;
+  int execfd;
+  char **argv;
+  pid_t pgid;
+  int infd;
+  int outfd;
+  int error;
+};
+
+static const size_t kTrampolineStackSize = 64 << 10;
+static char trampolineStack[kTrampolineStackSize] __attribute__((aligned(16)));
+
+/**
+ * Function: runTrampoline
+ * -----------------------
+ * Runs in the cloned child, on trampolineStack and in the shell's own memory,
+ * while the shell is suspended.  It must never touch the job list or throw, since
+ * anything it changes is changed in the shell as well.
+ */
+static int runTrampoline(void *arg) {
+  trampoline *t = static_cast<trampoline *>(arg);
+  setpgid(0, t->pgid);
+  if (t->infd != -1) dup2(t->infd, STDIN_FILENO);
+  if (t->outfd != -1) dup2(t->outfd, STDOUT_FILENO);
+  resetChildSignals();
+  markDescriptorsCloseOnExec();
+  execute(t->path, t->execfd, t->argv);
+  t->error = errno;
+  _exit(kExecFailed);
+}
+
+/**
+ * Function: cloneProcess
+ * ----------------------
+ * Launches the executable at path through runTrampoline, with every signal blocked until
+ * the child has reset its handlers, so none of the shell's handlers can run in the
+ * child.  If clone itself isn't available, the command is launched via forkProcess
+ * instead.  Returns -1, with errno set, if the command couldn't be run.
+ */
+static pid_t cloneProcess(const char *path, int execfd, char *argv[], pid_t pgid, int infd, int outfd) {
+  trampoline t = {path, execfd, argv, pgid, infd, outfd, 0};
+  sigset_t all, existing;
+  sigfillset(&all);
+  sigprocmask(SIG_SETMASK, &all, &existing);
+  pid_t pid = clone(runTrampoline, trampolineStack + kTrampolineStackSize,
+                    CLONE_VM | CLONE_VFORK | SIGCHLD, &t);
+  if (pid > 0 && t.error != 0) {
+    waitpid(pid, NULL, 0); // it has already exited
+    pid = -1;
+  }
+
+  sigprocmask(SIG_SETMASK, &existing, NULL);
+  if (pid == -1 && t.error == 0) return forkProcess(path, execfd, argv, pgid, infd, outfd);
+  if (pid == -1) errno = t.error;
+  return pid;
+}
+
+/**
+ * Function: zygoteProcess
+ * -----------------------
+ * Has the zygote launch the executable at path.  The zygote only ever receives
+ * the two descriptors the process needs.  If the zygote has gone away, the process
+ * is launched via forkProcess instead.  Returns -1, with errno set, if the command
+ * couldn't be run.
+ */
+static pid_t zygoteProcess(const char *path, char *argv[], pid_t pgid, int infd, int outfd) {
+  pid_t pid = zygoteLaunch(path, argv, pgid, infd, outfd);
+  if (pid == -1 && !zygoteRunning()) return forkProcess(path, -1, argv, pgid, infd, outfd);
+  return pid;
+}
+
+int openRedirection(const string& file, int flags) {
+  if (file.empty()) return -1;
+  int fd = open(file.c_str(), flags | O_CLOEXEC, 0644);
+  if (fd == -1) throw STSHException("Could not open \"" + file + "\".");
+  return fd;
+}
+
+/**
+ * Function: reportMissingDescriptor
+ * ---------------------------------
+ * Reports that no pidfd could be opened for the process with the provided pid, with
+ * errno describing why, unless the kernel simply doesn't support them or this has
+ * already been reported once.  The process is still tracked, by pid alone.
+ */
+static void reportMissingDescriptor(pid_t pid) {
+  static bool reported = false;
+  if (reported || errno == ENOSYS) return;
+  reported = true;
+  cerr << "Could not open a pidfd for process " << pid << " (" << strerror(errno)
+       << "), so it's tracked by pid alone.  Further failures won't be reported." << endl;
+}
+
+/**
+ * Function: launchProcess
+ * -----------------------
+ * Resolves the provided command, launches it with the current engine, and
+ * adds it to the job.  Reports the problem and returns without adding
+ * anything if the command can't be run.
+ */
+static void launchProcess(const command& cmd, STSHJobList& joblist, STSHJob& job, int infd, int outfd) {
+  string path;
+  if (!commandHash.lookup(cmd.command, path)) {
+    cerr << cmd.command << ": Command not found." << endl;
+    return;
+  }
+
+  char *argv[kMaxArguments + 2];
+  argv[0] = const_cast<char *>(cmd.command);
+  size_t argc = 1;
+  for (size_t j = 0; cmd.tokens[j] != NULL; j++) argv[argc++] = cmd.tokens[j];
+  argv[argc] = NULL;
+
+  pid_t pgid = job.getGroupID();
+  pid_t pid;
+  switch (engine) {
+  case kSpawnEngine: pid = spawnProcess(path.c_str(), argv, pgid, infd, outfd); break;
+  case kCloneEngine: pid = cloneProcess(path.c_str(), execCache.lookup(cmd.command, path), argv, pgid, infd, outfd); break;
+  case kZygoteEngine: pid = zygoteProcess(path.c_str(), argv, pgid, infd, outfd); break;
+  default: pid = forkProcess(path.c_str(), execCache.lookup(cmd.command, path), argv, pgid, infd, outfd); break;
+  }
+
+  if (pid == -1) {
+    if (errno == ENOENT) cerr << argv[0] << ": Command not found." << endl;
+    else cerr << argv[0] << ": " << strerror(errno) << endl;
+    return;
+  }
+
+  STSHProcess process(pid);
+  if (!process.openDescriptor()) reportMissingDescriptor(pid);
+  joblist.addProcess(job, process, cmd);
+  setpgid(pid, job.getGroupID());
+}
+
+/**
+ * Function: startTrailingCommand
+ * ------------------------------
+ * Starts the provided in-process command, the last in its pipeline, on a thread of its
+ * own (see startInProcessCommand), writing to outfd, or to standard output if outfd is -1.
+ * Returns the read end of a pipe whose write end the thread closes once it's done, or -1
+ * if the pipe couldn't be created, in which case the command has already been run.
+ */
+static int startTrailingCommand(const command& cmd, int outfd) {
+  int done[2];
+  if (pipe2(done, O_CLOEXEC) == -1) {
+    runInProcessCommand(cmd, outfd == -1 ? STDOUT_FILENO : outfd);
+    return -1;
+  }
+
+  if (outfd == -1) cout.flush(); // so nothing already printed comes out after
+  startInProcessCommand(cmd, fcntl(outfd == -1 ? STDOUT_FILENO : outfd, F_DUPFD_CLOEXEC, 0), done[1]);
+  return done[0];
+}
+
+int launchPipeline(const pipeline& p, STSHJobList& joblist, STSHJob& job) {
+  size_t count = p.commands.size();
+  int infd = openRedirection(p.input, O_RDONLY);
+  int outfd = -1, done = -1;
+  try {
+    outfd = openRedirection(p.output, O_WRONLY | O_CREAT | O_TRUNC);
+  } catch (...) {
+    if (infd != -1) close(infd);
+    throw;
+  }
+
+  // Each pipe is created just before the command writing to it is launched, and each end is
+  // closed as soon as the command that needs it has been launched, so the shell never holds more
+  // than three descriptors at once, however long the pipeline.  Every descriptor is close-on-exec,
+  // so children only keep the ones they dup2 into place.
+  if (commandHash.revalidate()) execCache.clear(); // something in PATH changed, so the descriptors may be stale
+  for (size_t i = 0; i < count; i++) {
+    int fds[2] = {-1, -1};
+    if (i + 1 < count && pipe2(fds, O_CLOEXEC) == -1) {
+      if (infd != -1) close(infd);
+      if (outfd != -1) close(outfd);
+      throw STSHException("Could not create a pipe.");
+    }
+
+    const command& cmd = p.commands[i];
+    if (!isInProcessCommand(cmd)) launchProcess(cmd, joblist, job, infd, i + 1 < count ? fds[1] : outfd);
+    else if (i + 1 < count) startInProcessCommand(cmd, fcntl(fds[1], F_DUPFD_CLOEXEC, 0));
+    else done = startTrailingCommand(cmd, outfd);
+    if (infd != -1) close(infd);
+    if (fds[1] != -1) close(fds[1]);
+    infd = fds[0];
+  }
+
+  if (outfd != -1) close(outfd);
+  return done;
+}
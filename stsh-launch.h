@@ -0,0 +1,121 @@
+/**
+ * File: stsh-launch.h
+ * -------------------
+ * Defines the functions stsh uses to launch all of the processes making
+ * up a pipeline.  The actual process creation is delegated to one of
+ * several launch engines, which can be swapped at runtime via the launch builtin:
+ *
+ *   fork:  the classic approach, where a full copy of the shell is forked for each
+ *          stage, and the child wires up its own file descriptors before it execs.
+ *   spawn: relies on posix_spawn, with the process group and all of the
+ *          redirections expressed as spawn attributes and file actions, so
+ *          that the shell's address space is never duplicated.
+ *   clone: clones a child that shares the shell's memory and runs on a small
+ *          dedicated stack, and whose only job is to join the process group, dup2
+ *          its descriptors into place, and exec.  If clone isn't available,
+ *          the process is forked instead.
+ *   zygote: sends each launch request to a helper process forked while the shell
+ *          was still small (see stsh-zygote.h), which forks and execv's on the
+ *          shell's behalf.  Selecting the engine starts the helper if it isn't
+ *          running yet; setting STSH_LAUNCH_ENGINE=zygote has it started at startup.
+ *
+ * Whatever the engine, commands are located through a shared STSHCommandHash,
+ * so PATH is only walked the first time a command is launched, and every engine
+ * execs the full path the hash resolved rather than searching PATH itself.  The fork
+ * and clone engines first try execveat on the O_PATH descriptor a shared STSHExecCache
+ * holds for the executable, and fall back to execve on the path if there's no
+ * descriptor or the kernel can't exec through it (e.g. for a script).
+ */
+
+#pragma once
+#include "stsh-parser/stsh-parse.h" // for struct pipeline
+#include "stsh-job-list.h"
+#include "stsh-command-hash.h"
+#include "stsh-exec-cache.h"
+#include <string>
+
+/**
+ * Enumerated Type: STSHLaunchEngine
+ * ---------------------------------
+ * Identifies the mechanism used to create the processes of a pipeline.
+ */
+enum STSHLaunchEngine { kForkEngine, kSpawnEngine, kCloneEngine, kZygoteEngine };
+
+/**
+ * Function: setLaunchEngine
+ * -------------------------
+ * Selects the launch engine, by name, to be used by all subsequent calls to launchPipeline.
+ * Returns false (without changing anything) if the name doesn't identify an engine, and
+ * throws an STSHException if the engine needs a zygote that can't be started.
+ */
+bool setLaunchEngine(const std::string& name);
+
+/**
+ * Function: getLaunchEngine, getLaunchEngineName
+ * ----------------------------------------------
+ * Return the currently selected launch engine and its name.
+ */
+STSHLaunchEngine getLaunchEngine();
+const char *getLaunchEngineName();
+
+/**
+ * Function: getCommandHash
+ * ------------------------
+ * Returns the STSHCommandHash used to locate the executable behind every command.
+ */
+STSHCommandHash& getCommandHash();
+
+/**
+ * Function: getExecCache
+ * ----------------------
+ * Returns the STSHExecCache holding descriptors for recently launched executables.
+ */
+STSHExecCache& getExecCache();
+
+/**
+ * Function: raiseDescriptorLimit
+ * ------------------------------
+ * Raises the soft limit on open descriptors as far as the hard limit allows, and
+ * returns the new soft limit.  Every process stsh launches holds a pidfd (see
+ * STSHProcess::openDescriptor) for as long as it's in the job list, so the usual soft
+ * limit of 1024 would run out after a thousand or so background processes.
+ */
+size_t raiseDescriptorLimit();
+
+/**
+ * Function: resetChildSignals
+ * ---------------------------
+ * Called in a new process just before it execs, to undo the signal setup stsh
+ * applies to itself: nothing is left blocked, and every signal stsh handles or
+ * ignores is restored to its default disposition.
+ */
+void resetChildSignals();
+
+/**
+ * Function: openRedirection
+ * -------------------------
+ * Opens the named redirection file with the supplied flags, or returns -1
+ * if there's no redirection to be made.  The descriptor is close-on-exec, so
+ * children only keep the copy they dup2 into place.  Throws an STSHException
+ * if the file can't be opened.
+ */
+int openRedirection(const std::string& file, int flags);
+
+/**
+ * Function: launchPipeline
+ * ------------------------
+ * Launches one process for each command in the provided pipeline, connecting
+ * neighboring commands with pipes, applying the pipeline's input and output
+ * redirections, and placing every process in a process group led by the first one.
+ * Each process is added to the supplied job, which must be in the supplied job list,
+ * as it's created, along with a pidfd for it; the first time a pidfd can't be opened for
+ * any reason other than the kernel not supporting them, the problem is reported on standard
+ * error, since the process can only be tracked by pid.  In-process
+ * commands (see stsh-inprocess.h) don't become processes: each runs on a thread of its own.
+ * If the last command is one of them, launchPipeline returns a descriptor that polls as
+ * readable (hung up, in fact) once it has finished, which the caller should wait on, without
+ * holding up the event loop, before reporting a foreground job done, and then close.  Otherwise, it
+ * returns -1.  The caller is expected to have blocked SIGCHLD so the processes can't be
+ * reaped before they've been recorded.
+ */
+int launchPipeline(const pipeline& p, STSHJobList& joblist, STSHJob& job);
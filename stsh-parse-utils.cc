@@ -1,12 +1,13 @@
 /**
  * File: stsh-parse-utils.cc
  * -------------------------
- * Provides the implementation of parseNumber.
+ * Provides the implementations of parseNumber and parseNumberRanges.
  */
 
 #include "stsh-parse-utils.h"
 #include "stsh-exception.h"
 #include <cstdlib>
+#include <cctype>
 using namespace std;
 
 size_t parseNumber(const char *arg, const string& usage) {
@@ -16,3 +17,29 @@ size_t parseNumber(const char *arg, const string& usage) {
   if (*end != '\0' || num < 0) throw STSHException(usage);
   return num;
 }
+
+/**
+ * Function: parseBound
+ * --------------------
+ * Parses the nonnegative number at the front of arg, advancing arg past it.
+ */
+static size_t parseBound(const char *& arg, const string& usage) {
+  if (!isdigit(*arg)) throw STSHException(usage);
+  char *end;
+  size_t num = strtoul(arg, &end, 10);
+  arg = end;
+  return num;
+}
+
+vector<pair<size_t, size_t>> parseNumberRanges(const char *arg, const string& usage) {
+  if (arg == NULL) throw STSHException(usage);
+  vector<pair<size_t, size_t>> ranges;
+  while (true) {
+    size_t first = parseBound(arg, usage), last = first;
+    if (*arg == '-') last = parseBound(++arg, usage);
+    if (last < first) throw STSHException(usage);
+    ranges.push_back(make_pair(first, last));
+    if (*arg == '\0') return ranges;
+    if (*arg++ != ',') throw STSHException(usage);
+  }
+}
@@ -1,13 +1,15 @@
 /**
  * File: stsh-parse-utils.h
  * ------------------------
- * Defines a single function that's helpful for converting
+ * Defines a pair of functions that are helpful for converting
  * numeric strings to actual numbers.
  */
 
 #pragma once
 #include <string>  // for string
 #include <cstddef> // for size_t
+#include <vector>  // for vector
+#include <utility> // for pair
 
 /**
  * Function: parseNumber
@@ -16,3 +18,13 @@
  * converts it to a size_t, and returns it.
  */
 size_t parseNumber(const char *arg, const std::string& usage);
+
+/**
+ * Function: parseNumberRanges
+ * ---------------------------
+ * Accepts the provided comma-separated list of nonnegative numbers and inclusive
+ * ranges of them (e.g. "3-40,45"), and returns each one as a (first, last) pair,
+ * where a lone number is a range of one.  Throws an STSHException with the provided
+ * usage message if the list is malformed.
+ */
+std::vector<std::pair<size_t, size_t>> parseNumberRanges(const char *arg, const std::string& usage);
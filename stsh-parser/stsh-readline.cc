@@ -15,11 +15,13 @@
 #include <cctype>
 #include <locale>
 #include <getopt.h>
+#include <unistd.h>
 #include "string-utils.h"
 using namespace std;
 
 static string prompt = "stsh> ";
 static bool history = true;
+static rlinputhook_t inputHook = NULL;
 static const int kIncorrectUsage = 1;
 static void printUsage(const string& message, const string& executable) {
   cerr << "Error: " << message << endl;
@@ -53,10 +55,24 @@ void rlinit(int argc, char *argv[]) {
   if (argc > 0) printUsage("Too many arguments.", argv[0]);
 }
 
+static int hookedGetc(FILE *stream) {
+  inputHook(fileno(stream));
+  return rl_getc(stream);
+}
+
+void rlsetinputhook(rlinputhook_t hook) {
+  inputHook = hook;
+  rl_getc_function = hook == NULL ? rl_getc : hookedGetc;
+}
+
 bool readline(string& line) {
   line.clear();
   if (!history) {
     cout << prompt;
+    if (inputHook != NULL && isatty(STDIN_FILENO)) {
+      cout.flush();
+      inputHook(STDIN_FILENO);
+    }
     getline(cin, line);
     trim(line);
     return !cin.eof();
@@ -19,6 +19,19 @@
  */
 void rlinit(int argc, char *argv[]);
 
+/**
+ * Function: rlsetinputhook
+ * ------------------------
+ * Installs a function that's called whenever readline is about to block
+ * waiting for more input, with the descriptor it's about to read from.  The hook
+ * is expected to return once that descriptor is readable, and is free to attend
+ * to other matters in the meantime.  Without GNU readline (i.e. with --no-history), the
+ * hook is only called when input is coming from a terminal, since then nothing
+ * beyond the current line is ever buffered.
+ */
+typedef void (*rlinputhook_t)(int fd);
+void rlsetinputhook(rlinputhook_t hook);
+
 /**
  * Function: readline
  * ------------------
@@ -5,29 +5,145 @@
  */
 
 #include "stsh-process.h"
-#include <iomanip>  // for setw, left
+#include <cstdio>   // for snprintf
+#include <csignal>  // for kill
+#include <unistd.h> // for syscall, close
+#include <sys/syscall.h>
+#include <sys/wait.h>
 using namespace std;
 
-STSHProcess::STSHProcess(pid_t pid, const command& command, STSHProcessState state) : pid(pid), state(state) {
-  tokens.push_back(command.command);
-  for (char * const *tokenp = &command.tokens[0]; *tokenp != NULL; tokenp++)
-    tokens.push_back(*tokenp);
+#ifndef P_PIDFD
+#define P_PIDFD 3
+#endif
+
+void STSHProcess::setCommandLine(const string *text, size_t offset, size_t length) {
+  this->text = text;
+  this->offset = offset;
+  this->length = length;
+}
+
+void STSHProcess::setState(STSHProcessState state) {
+  this->state = state;
+  if (state == kTerminated && pidfd != -1) {
+    close(pidfd);
+    pidfd = -1;
+  }
+}
+
+bool STSHProcess::openDescriptor() {
+#ifdef SYS_pidfd_open
+  if (pidfd == -1) pidfd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+  return pidfd != -1;
+}
+
+int STSHProcess::signal(int sig) const {
+#ifdef SYS_pidfd_send_signal
+  if (pidfd != -1) return syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0);
+#endif
+  return kill(pid, sig);
 }
 
-static ostream& operator<<(ostream& os, STSHProcessState state) {
-  const char *str = "Unknown";
+/**
+ * The waitid wrapper doesn't expose the system call's fifth argument, which
+ * is where the kernel reports the resource usage of a terminated child, so the
+ * system call is made directly.
+ */
+bool STSHProcess::reap(STSHProcessState& state, struct rusage& usage) const {
+  if (pidfd == -1) return false;
+  siginfo_t info;
+  info.si_pid = 0;
+  if (syscall(SYS_waitid, P_PIDFD, pidfd, &info, WEXITED | WSTOPPED | WCONTINUED | WNOHANG, &usage) == -1 || info.si_pid == 0)
+    return false;
+  switch (info.si_code) {
+    case CLD_STOPPED: state = kStopped; break;
+    case CLD_CONTINUED: state = kRunning; break;
+    default: state = kTerminated; break; // CLD_EXITED, CLD_KILLED, or CLD_DUMPED
+  }
+
+  return true;
+}
+
+/**
+ * Function: getStateName
+ * ----------------------
+ * Returns the name a process's state is listed under.
+ */
+static const char *getStateName(STSHProcessState state) {
   switch (state) {
-    case kWaiting: str = "Waiting"; break;
-    case kRunning: str = "Running"; break;
-    case kStopped: str = "Stopped"; break;
-    case kTerminated: str = "Terminated"; break;
+    case kWaiting: return "Waiting";
+    case kRunning: return "Running";
+    case kStopped: return "Stopped";
+    case kTerminated: return "Terminated";
+  }
+
+  return "Unknown";
+}
+
+void STSHProcess::print(ostream& os, bool verbose) const {
+  string line;
+  append(line, verbose);
+  os << line;
+}
+
+/**
+ * Every field is formatted with snprintf into a buffer on the stack, so listing
+ * a process only ever allocates if out needs to grow.
+ */
+void STSHProcess::append(string& out, bool verbose) const {
+  char buffer[192];
+  out.append(buffer, snprintf(buffer, sizeof(buffer), "%5d %-12s", int(pid), getStateName(state)));
+  if (text != NULL) out.append(1, ' ').append(*text, offset, length);
+  if (!verbose || !reported) return;
+  out.append(buffer, snprintf(buffer, sizeof(buffer),
+                              " (user %ld.%03lds, sys %ld.%03lds, max rss %ldKB, faults %ld/%ld, switches %ld/%ld)",
+                              long(usage.ru_utime.tv_sec), long(usage.ru_utime.tv_usec / 1000),
+                              long(usage.ru_stime.tv_sec), long(usage.ru_stime.tv_usec / 1000),
+                              usage.ru_maxrss, usage.ru_minflt, usage.ru_majflt, usage.ru_nvcsw, usage.ru_nivcsw));
+}
+
+/**
+ * Function: appendJSONString
+ * --------------------------
+ * Appends the provided characters to out as a quoted JSON string, escaping
+ * quotes, backslashes, and control characters.
+ */
+static void appendJSONString(string& out, const char *chars, size_t length) {
+  out += '"';
+  for (size_t i = 0; i < length; i++) {
+    unsigned char ch = chars[i];
+    if (ch == '"' || ch == '\\') {
+      out += '\\';
+      out += ch;
+    } else if (ch < 0x20) {
+      char escaped[8];
+      out.append(escaped, snprintf(escaped, sizeof(escaped), "\\u%04x", ch));
+    } else {
+      out += ch;
+    }
+  }
+
+  out += '"';
+}
+
+void STSHProcess::appendJSON(string& out) const {
+  char buffer[256];
+  out.append(buffer, snprintf(buffer, sizeof(buffer), "{\"pid\":%d,\"state\":\"%s\",\"command\":", int(pid), getStateName(state)));
+  if (text != NULL) appendJSONString(out, text->data() + offset, length);
+  else out += "\"\"";
+  if (reported) {
+    out.append(buffer, snprintf(buffer, sizeof(buffer),
+                                ",\"usage\":{\"user\":%ld.%06ld,\"sys\":%ld.%06ld,\"maxrss\":%ld,"
+                                "\"minflt\":%ld,\"majflt\":%ld,\"nvcsw\":%ld,\"nivcsw\":%ld}",
+                                long(usage.ru_utime.tv_sec), long(usage.ru_utime.tv_usec),
+                                long(usage.ru_stime.tv_sec), long(usage.ru_stime.tv_usec),
+                                usage.ru_maxrss, usage.ru_minflt, usage.ru_majflt, usage.ru_nvcsw, usage.ru_nivcsw));
   }
 
-  return os << str;
+  out += '}';
 }
 
 ostream& operator<<(ostream& os, const STSHProcess& process) {
-  os << setw(5) << process.pid << " " << setw(12) << left << process.state << right;
-  for (const string& token: process.tokens) os << " " << token;
+  process.print(os, false);
   return os;
 }
@@ -13,10 +13,11 @@
  */
 
 #pragma once
-#include "stsh-parser/stsh-parse.h" // for struct command
-#include <vector>   // for vector
+#include <cstddef>  // for size_t
 #include <string>   // for string
 #include <iostream> // for ostream
+#include <sys/types.h> // for pid_t
+#include <sys/resource.h> // for struct rusage
 
 /**
  * Enumerated Type: STSHProcessState
@@ -48,15 +49,16 @@ public:
  * ------------------------
  * Default constructor, where the process id is set to 0 as a placeholder.
  */
-  STSHProcess(): pid(0) {}
+  STSHProcess(): pid(0), pidfd(-1), reported(false) {}
 
 /**
  * Constructor: STSHProcess
  * ------------------------
- * Constructs the object to package the provided pid, command line, and process state
- * together.
+ * Constructs the object to package the provided pid and process state together.
+ * The process's command line is supplied when it's added to a job (see STSHJob::addProcess),
+ * which is what owns the text.
  */
-  STSHProcess(pid_t pid, const command& command, STSHProcessState state = kRunning);
+  STSHProcess(pid_t pid, STSHProcessState state = kRunning) : pid(pid), pidfd(-1), state(state), reported(false) {}
 
 /**
  * Method: getID
@@ -65,6 +67,15 @@ public:
  */
   pid_t getID() const { return pid; }
 
+/**
+ * Method: setCommandLine
+ * ----------------------
+ * Makes the process's command line the length characters at the provided offset
+ * into text, which must outlive the process.  Called by STSHJob::addProcess,
+ * which passes its own arena, so copying a process never copies its command line.
+ */
+  void setCommandLine(const std::string *text, size_t offset, size_t length);
+
 /**
  * Method: getState
  * ----------------
@@ -76,12 +87,94 @@ public:
 /**
  * Method: setState
  * ----------------
- * Sets the state of the process to be that provided.
+ * Sets the state of the process to be that provided.  Once a process is
+ * terminated, its pidfd (if it has one) is closed, since there's nothing left to
+ * signal or wait on.
+ */
+  void setState(STSHProcessState state);
+
+/**
+ * Method: openDescriptor
+ * ----------------------
+ * Opens a pidfd referring to the process, via pidfd_open.  The pidfd keeps referring
+ * to this process even after its pid has been recycled, so signals sent and state
+ * changes collected through it can never reach some unrelated process.  Returns false
+ * if no pidfd could be opened (e.g. on kernels older than 5.3), in which case the process
+ * is tracked by pid alone.
+ */
+  bool openDescriptor();
+
+/**
+ * Method: getDescriptor
+ * ---------------------
+ * Returns the process's pidfd, or -1 if it doesn't have one.  The descriptor
+ * polls as readable once the process has terminated.
+ */
+  int getDescriptor() const { return pidfd; }
+
+/**
+ * Method: signal
+ * --------------
+ * Sends the provided signal to the process, via pidfd_send_signal if it has a
+ * pidfd and via kill otherwise.  Returns 0 on success and -1 on failure, just as
+ * kill does.
+ */
+  int signal(int sig) const;
+
+/**
+ * Method: reap
+ * ------------
+ * Collects the next pending state change of the process, if any, via
+ * waitid(P_PIDFD, ...), and places the process's new state in state.  If the process
+ * has terminated, its resource usage is placed in usage.  Returns false if there's
+ * no state change to collect, or if the process doesn't have a pidfd or isn't
+ * a child of stsh.  Never blocks, and is async-signal-safe.
+ */
+  bool reap(STSHProcessState& state, struct rusage& usage) const;
+
+/**
+ * Methods: hasUsage, getUsage, setUsage
+ * -------------------------------------
+ * Manage the resources (CPU time, maximum resident set size, page faults, and context
+ * switches) the process used over its lifetime, as reported by wait4 or waitid once
+ * it terminated.  getUsage should be guarded by a call to hasUsage.
+ */
+  bool hasUsage() const { return reported; }
+  const struct rusage& getUsage() const { return usage; }
+  void setUsage(const struct rusage& usage) { this->usage = usage; reported = true; }
+
+/**
+ * Method: print
+ * -------------
+ * Inserts the same serialization operator<< does into the provided ostream,
+ * followed by the process's resource usage if verbose is true and it's known.
+ */
+  void print(std::ostream& os, bool verbose) const;
+
+/**
+ * Method: append
+ * --------------
+ * Appends the same serialization print does to the provided string, without
+ * going through a stream.
+ */
+  void append(std::string& out, bool verbose) const;
+
+/**
+ * Method: appendJSON
+ * ------------------
+ * Appends a JSON object describing the process to the provided string: its pid,
+ * state, and command line, and its resource usage if it's known, e.g.
+ *
+ *   {"pid":4182,"state":"Running","command":"./spin 5"}
  */
-  void setState(STSHProcessState state) { this->state = state; }
+  void appendJSON(std::string& out) const;
 
 private:
   pid_t pid;
-  std::vector<std::string> tokens;
+  int pidfd;
+  const std::string *text = NULL; // the arena holding the command line, owned by the job
+  size_t offset = 0, length = 0;  // where the command line sits within it
   STSHProcessState state;
+  struct rusage usage;
+  bool reported; // true iff usage has been set
 };
@@ -0,0 +1,180 @@
+/**
+ * File: stsh-reap-bench.cc
+ * ------------------------
+ * Measures how quickly each of stsh's event loops notices that children have
+ * changed state while a large number of background jobs are alive.  For each event loop,
+ * a fresh process launches --jobs background jobs of --command, then times
+ * --rounds foreground jobs of /bin/true (the builtin true never forks) from launch
+ * until the event loop has reaped them, and finally kills every background job at
+ * once and times how long it takes for the job list to empty out, e.g.
+ *
+ *   ./stsh-reap-bench --jobs 10000 --loop uring < /dev/null
+ *
+ * Each event loop takes over SIGCHLD for good, so each one is measured in its own process.
+ */
+#include "stsh-event-loop.h"
+#include "stsh-launch.h"
+#include "stsh-exception.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/timerfd.h>
+using namespace std;
+
+static const char *const kEventLoops[] = {"signals", "epoll", "uring", "reaper"};
+static const size_t kNumEventLoops = sizeof(kEventLoops)/sizeof(kEventLoops[0]);
+
+static const int kIncorrectUsage = 1;
+static void printUsage(const string& message, const string& executable) {
+  cerr << "Error: " << message << endl;
+  cerr << "Usage: ./" << executable << " [--jobs n] [--rounds n] [--loop name] [--command line]" << endl;
+  exit(kIncorrectUsage);
+}
+
+static void extractArguments(int argc, char *argv[], size_t& jobs, size_t& rounds, string& loop, string& line) {
+  struct option options[] = {
+    {"jobs", required_argument, NULL, 'j'},
+    {"rounds", required_argument, NULL, 'r'},
+    {"loop", required_argument, NULL, 'l'},
+    {"command", required_argument, NULL, 'c'},
+    {NULL, 0, NULL, 0},
+  };
+
+  while (true) {
+    int ch = getopt_long(argc, argv, "j:r:l:c:", options, NULL);
+    if (ch == -1) break;
+    switch (ch) {
+    case 'j':
+      jobs = atoi(optarg);
+      break;
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    case 'l':
+      loop = optarg;
+      break;
+    case 'c':
+      line = optarg;
+      break;
+    default:
+      printUsage("Unrecognized flag.", argv[0]);
+    }
+  }
+
+  argc -= optind;
+  if (argc > 0) printUsage("Too many arguments.", argv[0]);
+  if (rounds == 0) printUsage("Rounds must be positive.", argv[0]);
+}
+
+/**
+ * Function: launchJob
+ * -------------------
+ * Launches the provided pipeline as a new job, just as stsh's createJob does, and waits
+ * for it to finish if it's a foreground job.  Returns the pid of its first process.
+ */
+static pid_t launchJob(STSHEventLoop *loop, STSHJobList& joblist, const pipeline& p, STSHJobState state) {
+  loop->lock();
+  STSHJob& job = joblist.addJob(state);
+  launchPipeline(p, joblist, job);
+  loop->watch(job);
+  pid_t pid = job.getProcesses().empty() ? -1 : job.getProcesses()[0].getID();
+  joblist.synchronize(job);
+  loop->waitForForegroundJob();
+  loop->unlock();
+  return pid;
+}
+
+/**
+ * Function: waitForEmptyJobList
+ * -----------------------------
+ * Processes events until every job in the job list is gone.  Event loops that can't
+ * watch descriptors return from waitForInput right away, so the timer is polled
+ * directly as well, so that they sleep between ticks rather than spin.
+ */
+static void waitForEmptyJobList(STSHEventLoop *loop, STSHJobList& joblist) {
+  static const long kTickNanoseconds = 1000000;
+  int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  struct itimerspec tick = {{0, kTickNanoseconds}, {0, kTickNanoseconds}};
+  timerfd_settime(timer, 0, &tick, NULL);
+  while (true) {
+    loop->lock();
+    bool empty = joblist.size() == 0;
+    loop->unlock();
+    if (empty) break;
+    loop->waitForInput(timer);
+    struct pollfd fd = {timer, POLLIN, 0};
+    ::poll(&fd, 1, -1);
+    uint64_t expirations;
+    if (read(timer, &expirations, sizeof(expirations)) == -1) {} // just rearming the timer
+    loop->poll();
+  }
+
+  close(timer);
+}
+
+/**
+ * Function: benchmarkEventLoop
+ * ----------------------------
+ * Runs the whole benchmark against the named event loop, and prints a one-line summary.
+ * Meant to be run in a process of its own.
+ */
+static void benchmarkEventLoop(const string& name, size_t jobs, size_t rounds, const string& line) {
+  STSHJobList joblist;
+  STSHEventLoop *loop = STSHEventLoop::create(name, joblist);
+  pipeline background(line + " &"), foreground("/bin/true");
+  vector<pid_t> pids;
+  for (size_t i = 0; i < jobs; i++) pids.push_back(launchJob(loop, joblist, background, kBackground));
+
+  double total = 0, worst = 0;
+  for (size_t i = 0; i < rounds; i++) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    launchJob(loop, joblist, foreground, kForeground);
+    double usecs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    total += usecs;
+    worst = max(worst, usecs);
+  }
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for (pid_t pid: pids) kill(pid, SIGKILL);
+  waitForEmptyJobList(loop, joblist);
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << setw(7) << name << ": " << fixed << setprecision(1) << total / rounds << "us per foreground job (worst "
+       << worst << "us), " << setprecision(3) << secs << "s to reap all " << jobs << " background jobs" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  size_t jobs = 10000, rounds = 100;
+  string loop, line = "./spin 600";
+  extractArguments(argc, argv, jobs, rounds, loop, line);
+  if (!loop.empty() && find(kEventLoops, kEventLoops + kNumEventLoops, loop) == kEventLoops + kNumEventLoops)
+    printUsage("Unknown event loop.", argv[0]);
+  size_t limit = raiseDescriptorLimit();
+  if (jobs >= limit) cerr << "Warning: only " << limit << " descriptors can be open at once, so some processes won't have pidfds." << endl;
+  cout << "Timing " << rounds << " foreground jobs alongside " << jobs << " background jobs of \""
+       << line << "\"." << endl;
+  for (size_t i = 0; i < kNumEventLoops; i++) {
+    if (!loop.empty() && loop != kEventLoops[i]) continue;
+    pid_t pid = fork();
+    if (pid == 0) {
+      try {
+        benchmarkEventLoop(kEventLoops[i], jobs, rounds, line);
+      } catch (const STSHException& e) {
+        cerr << kEventLoops[i] << ": " << e.what() << endl;
+      }
+      exit(0);
+    }
+
+    waitpid(pid, NULL, 0);
+  }
+
+  return 0;
+}
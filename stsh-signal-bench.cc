@@ -0,0 +1,201 @@
+/**
+ * File: stsh-signal-bench.cc
+ * --------------------------
+ * Measures how long each of stsh's event loops takes to forward a SIGINT
+ * to a foreground job with many processes and reap the lot, and checks
+ * that none of the event loop's signal handlers allocate memory along the way.
+ * For each event loop, a fresh process launches --rounds foreground pipelines of --width
+ * copies of --command, sends itself SIGINT once each one is running, and times how
+ * long it takes for waitForForegroundJob to return, e.g.
+ *
+ *   ./stsh-signal-bench --width 1000 --loop signals < /dev/null
+ *
+ * malloc, calloc, and realloc are interposed on, and every handler the event loop
+ * installed is wrapped by one that notes it's running, so that any allocation made
+ * while a handler is on the stack is counted.
+ */
+#include "stsh-event-loop.h"
+#include "stsh-launch.h"
+#include "stsh-exception.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+using namespace std;
+
+static volatile sig_atomic_t handlersRunning = 0;
+static volatile sig_atomic_t handlerAllocations = 0;
+
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+extern "C" void *malloc(size_t size) {
+  if (handlersRunning > 0) handlerAllocations = handlerAllocations + 1;
+  return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size) {
+  if (handlersRunning > 0) handlerAllocations = handlerAllocations + 1;
+  return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size) {
+  if (handlersRunning > 0) handlerAllocations = handlerAllocations + 1;
+  return __libc_realloc(ptr, size);
+}
+
+static const int kWatchedSignals[] = {SIGCHLD, SIGINT, SIGTSTP};
+static const size_t kNumWatchedSignals = sizeof(kWatchedSignals)/sizeof(kWatchedSignals[0]);
+static struct sigaction wrapped[NSIG];
+
+/**
+ * Function: countingHandler
+ * -------------------------
+ * Calls the handler the event loop installed for sig, noting that a handler is
+ * on the stack for as long as it runs.
+ */
+static void countingHandler(int sig) {
+  handlersRunning = handlersRunning + 1;
+  wrapped[sig].sa_handler(sig);
+  handlersRunning = handlersRunning - 1;
+}
+
+/**
+ * Function: wrapHandlers
+ * ----------------------
+ * Wraps every handler the event loop installed (there are none if it
+ * receives signals through a descriptor) in countingHandler, keeping its mask and flags.
+ */
+static void wrapHandlers() {
+  for (size_t i = 0; i < kNumWatchedSignals; i++) {
+    int sig = kWatchedSignals[i];
+    sigaction(sig, NULL, &wrapped[sig]);
+    if (wrapped[sig].sa_handler == SIG_DFL || wrapped[sig].sa_handler == SIG_IGN) continue;
+    struct sigaction action = wrapped[sig];
+    action.sa_handler = countingHandler;
+    sigaction(sig, &action, NULL);
+  }
+}
+
+static const char *const kEventLoops[] = {"signals", "epoll", "uring", "reaper"};
+static const size_t kNumEventLoops = sizeof(kEventLoops)/sizeof(kEventLoops[0]);
+
+static const int kIncorrectUsage = 1;
+static void printUsage(const string& message, const string& executable) {
+  cerr << "Error: " << message << endl;
+  cerr << "Usage: ./" << executable << " [--width n] [--rounds n] [--loop name] [--command line]" << endl;
+  exit(kIncorrectUsage);
+}
+
+static void extractArguments(int argc, char *argv[], size_t& width, size_t& rounds, string& loop, string& line) {
+  struct option options[] = {
+    {"width", required_argument, NULL, 'w'},
+    {"rounds", required_argument, NULL, 'r'},
+    {"loop", required_argument, NULL, 'l'},
+    {"command", required_argument, NULL, 'c'},
+    {NULL, 0, NULL, 0},
+  };
+
+  while (true) {
+    int ch = getopt_long(argc, argv, "w:r:l:c:", options, NULL);
+    if (ch == -1) break;
+    switch (ch) {
+    case 'w':
+      width = atoi(optarg);
+      break;
+    case 'r':
+      rounds = atoi(optarg);
+      break;
+    case 'l':
+      loop = optarg;
+      break;
+    case 'c':
+      line = optarg;
+      break;
+    default:
+      printUsage("Unrecognized flag.", argv[0]);
+    }
+  }
+
+  argc -= optind;
+  if (argc > 0) printUsage("Too many arguments.", argv[0]);
+  if (width == 0) printUsage("Width must be positive.", argv[0]);
+  if (rounds == 0) printUsage("Rounds must be positive.", argv[0]);
+}
+
+/**
+ * Function: interruptJob
+ * ----------------------
+ * Launches the provided pipeline in the foreground, just as stsh's createJob does,
+ * interrupts it once it's fully launched, and returns the number of microseconds
+ * between the SIGINT and the job being gone.
+ */
+static double interruptJob(STSHEventLoop *loop, STSHJobList& joblist, const pipeline& p) {
+  loop->lock();
+  STSHJob& job = joblist.addJob(kForeground);
+  launchPipeline(p, joblist, job);
+  loop->watch(job);
+  joblist.synchronize(job);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  kill(getpid(), SIGINT); // stays pending (or queued in the signalfd) until the loop waits
+  loop->waitForForegroundJob();
+  loop->unlock();
+  return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Function: benchmarkEventLoop
+ * ----------------------------
+ * Runs the whole benchmark against the named event loop, and prints a one-line summary.
+ * Meant to be run in a process of its own.
+ */
+static void benchmarkEventLoop(const string& name, size_t width, size_t rounds, const string& command) {
+  STSHJobList joblist;
+  STSHEventLoop *loop = STSHEventLoop::create(name, joblist);
+  wrapHandlers();
+  string line = command;
+  for (size_t i = 1; i < width; i++) line += " | " + command;
+  pipeline p(line);
+  double total = 0, worst = 0;
+  for (size_t i = 0; i < rounds; i++) {
+    double usecs = interruptJob(loop, joblist, p);
+    total += usecs;
+    worst = max(worst, usecs);
+  }
+
+  cout << setw(7) << name << ": " << fixed << setprecision(1) << total / rounds << "us to interrupt and reap (worst "
+       << worst << "us), " << handlerAllocations << " allocations inside signal handlers" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  size_t width = 1000, rounds = 10;
+  string loop, command = "./spin 600";
+  extractArguments(argc, argv, width, rounds, loop, command);
+  if (!loop.empty() && find(kEventLoops, kEventLoops + kNumEventLoops, loop) == kEventLoops + kNumEventLoops)
+    printUsage("Unknown event loop.", argv[0]);
+  raiseDescriptorLimit(); // every process holds a pidfd
+  cout << "Interrupting " << rounds << " foreground jobs of " << width << " \"" << command << "\"s." << endl;
+  for (size_t i = 0; i < kNumEventLoops; i++) {
+    if (!loop.empty() && loop != kEventLoops[i]) continue;
+    pid_t pid = fork();
+    if (pid == 0) {
+      try {
+        benchmarkEventLoop(kEventLoops[i], width, rounds, command);
+      } catch (const STSHException& e) {
+        cerr << kEventLoops[i] << ": " << e.what() << endl;
+      }
+      exit(0);
+    }
+
+    waitpid(pid, NULL, 0);
+  }
+
+  return 0;
+}
@@ -0,0 +1,78 @@
+/**
+ * File: stsh-timer-wheel.cc
+ * -------------------------
+ * Presents the implementation of the STSHTimerWheel class.
+ */
+
+#include "stsh-timer-wheel.h"
+using namespace std;
+
+STSHTimerWheel::STSHTimerWheel(uint64_t now): next(now / kTickMilliseconds), count(0) {}
+
+void STSHTimerWheel::add(uint64_t expires, uint64_t value) {
+  timer t = {(expires + kTickMilliseconds - 1) / kTickMilliseconds, value};
+  if (t.tick < next) t.tick = next;
+  place(t);
+  count++;
+}
+
+/**
+ * Method: place
+ * -------------
+ * Files the provided timer under the lowest level whose span reaches
+ * its tick, clamping timers beyond the top level's reach to its far end.
+ */
+void STSHTimerWheel::place(const timer& t) {
+  uint64_t delta = t.tick - next;
+  for (size_t level = 0; level < kLevels; level++) {
+    if (delta < (uint64_t(1) << (kSlotBits * (level + 1))) || level == kLevels - 1) {
+      timer placed = t;
+      if (level == kLevels - 1 && delta >= (uint64_t(1) << (kSlotBits * kLevels))) {
+        placed.tick = next + (uint64_t(1) << (kSlotBits * kLevels)) - 1;
+      }
+
+      slots[level][(placed.tick >> (kSlotBits * level)) & (kSlots - 1)].push_back(placed);
+      return;
+    }
+  }
+}
+
+/**
+ * Method: cascade
+ * ---------------
+ * Refiles every timer in the provided level's current slot, each of which
+ * now lands in a lower level.
+ */
+void STSHTimerWheel::cascade(size_t level) {
+  vector<timer> cascading;
+  cascading.swap(slots[level][(next >> (kSlotBits * level)) & (kSlots - 1)]);
+  for (const timer& t: cascading) place(t);
+}
+
+void STSHTimerWheel::advance(uint64_t now, vector<uint64_t>& expired) {
+  uint64_t target = now / kTickMilliseconds;
+  while (next <= target && count > 0) {
+    for (size_t level = 1; level < kLevels; level++) {
+      if (((next >> (kSlotBits * (level - 1))) & (kSlots - 1)) != 0) break; // the level below didn't wrap
+      cascade(level);
+    }
+
+    vector<timer>& slot = slots[0][next & (kSlots - 1)];
+    for (const timer& t: slot) expired.push_back(t.value);
+    count -= slot.size();
+    slot.clear();
+    next++;
+  }
+
+  if (count == 0 && next <= target) next = target + 1; // nothing to cascade, so skip ahead
+}
+
+long STSHTimerWheel::getTimeout(uint64_t now) const {
+  if (count == 0) return -1;
+  for (uint64_t tick = next;; tick++) {
+    if (!slots[0][tick & (kSlots - 1)].empty() || (tick & (kSlots - 1)) == 0) {
+      uint64_t when = tick * kTickMilliseconds;
+      return when <= now ? 0 : long(when - now);
+    }
+  }
+}
@@ -0,0 +1,89 @@
+/**
+ * File: stsh-timer-wheel.h
+ * ------------------------
+ * Defines the STSHTimerWheel class, a hierarchical timing wheel that
+ * keeps track of any number of timers, each identified by an arbitrary 64-bit
+ * value, in constant time per timer.  Time is measured in milliseconds, and
+ * timers expire with a granularity of kTickMilliseconds.
+ *
+ * The wheel has kLevels levels of kSlots slots each.  A timer due within kSlots ticks
+ * sits in the level-0 slot for its tick; one due later sits in a slot of a higher
+ * level, each of which covers kSlots times as long a span as the level below, and is
+ * cascaded down a level whenever the level below wraps around.  No timer is ever
+ * compared against any other.
+ *
+ * Usage:
+ *
+ *    STSHTimerWheel wheel(now);
+ *    wheel.add(now + 5000, 17);
+ *    ...
+ *    vector<uint64_t> expired;
+ *    wheel.advance(now, expired); // expired holds 17 once five seconds have passed
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class STSHTimerWheel {
+public:
+  static const uint64_t kTickMilliseconds = 10;
+
+/**
+ * Constructor: STSHTimerWheel
+ * ---------------------------
+ * Constructs an empty wheel whose clock reads now.
+ */
+  STSHTimerWheel(uint64_t now);
+
+/**
+ * Method: add
+ * -----------
+ * Arms a timer that expires at the provided time (rounded up to the next tick),
+ * and reports the provided value when it does.  A time in the past expires on
+ * the next call to advance.
+ */
+  void add(uint64_t expires, uint64_t value);
+
+/**
+ * Method: advance
+ * ---------------
+ * Moves the wheel's clock forward to now, and appends the value of every timer
+ * that expired along the way to expired, in order of expiration.
+ */
+  void advance(uint64_t now, std::vector<uint64_t>& expired);
+
+/**
+ * Method: getTimeout
+ * ------------------
+ * Returns how many milliseconds can elapse after now before advance needs to be
+ * called again, or -1 if no timers are armed.  Far-off timers cost a wake-up
+ * every kSlots ticks, so they can be cascaded toward level 0.
+ */
+  long getTimeout(uint64_t now) const;
+
+/**
+ * Method: size
+ * ------------
+ * Returns the number of armed timers.
+ */
+  size_t size() const { return count; }
+
+private:
+  static const unsigned kSlotBits = 6;
+  static const size_t kSlots = 1 << kSlotBits;
+  static const size_t kLevels = 4;
+
+  struct timer {
+    uint64_t tick;
+    uint64_t value;
+  };
+
+  std::vector<timer> slots[kLevels][kSlots];
+  uint64_t next;   // the next tick to be processed
+  size_t count;
+
+  void place(const timer& t);
+  void cascade(size_t level);
+};
@@ -0,0 +1,147 @@
+/**
+ * File: stsh-uring.cc
+ * -------------------
+ * Presents the implementation of the STSHUring class.  The memory
+ * shared with the kernel is laid out as described in io_uring(7).
+ */
+
+#include "stsh-uring.h"
+#include "stsh-exception.h"
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+using namespace std;
+
+/**
+ * Function: mapRing
+ * -----------------
+ * Maps the region of the io_uring at the provided offset, or returns NULL
+ * if it can't be mapped.
+ */
+static void *mapRing(int fd, size_t size, off_t offset) {
+  void *ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+  return ring == MAP_FAILED ? NULL : ring;
+}
+
+STSHUring::STSHUring(unsigned entries): sqRing(NULL), cqRing(NULL), sqes(NULL), tail(0), pending(0) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  fd = syscall(SYS_io_uring_setup, entries, &params);
+  if (fd == -1) throw STSHException("Could not set up an io_uring.");
+  if ((params.features & IORING_FEAT_EXT_ARG) == 0) {
+    close(fd);
+    throw STSHException("This kernel's io_uring can't wait with a timeout.");
+  }
+
+  this->entries = params.sq_entries;
+  sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+  sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  sqRing = mapRing(fd, sqRingSize, IORING_OFF_SQ_RING);
+  cqRing = params.features & IORING_FEAT_SINGLE_MMAP ? sqRing : mapRing(fd, cqRingSize, IORING_OFF_CQ_RING);
+  sqes = static_cast<struct io_uring_sqe *>(mapRing(fd, sqesSize, IORING_OFF_SQES));
+  if (sqRing == NULL || cqRing == NULL || sqes == NULL) {
+    release();
+    throw STSHException("Could not map an io_uring.");
+  }
+
+  char *sq = static_cast<char *>(sqRing), *cq = static_cast<char *>(cqRing);
+  sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+  sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sqMask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cqMask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+  tail = *sqTail;
+}
+
+STSHUring::~STSHUring() {
+  release();
+}
+
+/**
+ * Method: release
+ * ---------------
+ * Unmaps whatever was mapped and closes the io_uring.
+ */
+void STSHUring::release() {
+  if (sqes != NULL) munmap(sqes, sqesSize);
+  if (cqRing != NULL && cqRing != sqRing) munmap(cqRing, cqRingSize);
+  if (sqRing != NULL) munmap(sqRing, sqRingSize);
+  close(fd);
+}
+
+/**
+ * Method: getSQE
+ * --------------
+ * Claims the next free submission queue entry, zeroed out, submitting whatever's
+ * already been prepared if the queue is full.
+ */
+struct io_uring_sqe *STSHUring::getSQE() {
+  while (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == entries) enter(0, 0);
+  unsigned index = tail & *sqMask;
+  struct io_uring_sqe *sqe = &sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqArray[index] = index;
+  tail++;
+  pending++;
+  return sqe;
+}
+
+void STSHUring::prepareRead(int fd, void *buffer, unsigned len, uint64_t tag) {
+  struct io_uring_sqe *sqe = getSQE();
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = fd;
+  sqe->addr = reinterpret_cast<uint64_t>(buffer);
+  sqe->len = len;
+  sqe->off = uint64_t(-1); // read from the current position, which is all a signalfd or terminal has
+  sqe->user_data = tag;
+}
+
+void STSHUring::preparePoll(int fd, short events, uint64_t tag) {
+  struct io_uring_sqe *sqe = getSQE();
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = fd;
+  sqe->poll32_events = events;
+  sqe->user_data = tag;
+}
+
+/**
+ * Method: enter
+ * -------------
+ * Publishes every prepared request and calls io_uring_enter to submit them, and to wait
+ * for waitFor completions for up to timeout milliseconds.  Returns what io_uring_enter does.
+ */
+int STSHUring::enter(unsigned waitFor, int timeout) {
+  __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+  unsigned flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG; // even with waitFor == 0, so overflowed completions are flushed
+  struct __kernel_timespec ts;
+  ts.tv_sec = timeout / 1000;
+  ts.tv_nsec = (timeout % 1000) * 1000000L;
+  struct io_uring_getevents_arg arg;
+  memset(&arg, 0, sizeof(arg));
+  arg.ts = timeout < 0 ? 0 : reinterpret_cast<uint64_t>(&ts);
+  int result = syscall(SYS_io_uring_enter, fd, pending, waitFor, flags, &arg, sizeof(arg));
+  if (result >= 0) pending -= min(unsigned(result), pending);
+  return result;
+}
+
+bool STSHUring::submit(int timeout) {
+  return enter(timeout == 0 ? 0 : 1, timeout) >= 0;
+}
+
+bool STSHUring::nextCompletion(uint64_t& tag, int& result) {
+  unsigned head = *cqHead;
+  if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) return false;
+  struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+  tag = cqe->user_data;
+  result = cqe->res;
+  __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
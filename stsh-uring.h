@@ -0,0 +1,82 @@
+/**
+ * File: stsh-uring.h
+ * ------------------
+ * Defines the STSHUring class, a thin wrapper around an io_uring instance
+ * that speaks to the kernel through the raw io_uring_setup and io_uring_enter
+ * system calls, so stsh doesn't depend on liburing.  It only supports the handful
+ * of operations the io_uring event loop needs.
+ *
+ * Requests are prepared into the submission queue without any system call, and
+ * handed to the kernel all at once by the next call to submit, which can also wait for
+ * completions, so each round trip costs exactly one io_uring_enter.  Every request carries
+ * a 64-bit tag, which comes back with its completion.
+ */
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+class STSHUring {
+public:
+
+/**
+ * Constructor: STSHUring
+ * ----------------------
+ * Sets up an io_uring with room for the provided number of requests in its
+ * submission queue.  Throws an STSHException if io_uring isn't available, or if
+ * the kernel is too old to support waiting with a timeout (Linux 5.11 or later is needed).
+ */
+  STSHUring(unsigned entries);
+  ~STSHUring();
+
+/**
+ * Methods: prepareRead, preparePoll
+ * ---------------------------------
+ * Queue up a read of up to len bytes from fd into buffer, or a one-shot poll
+ * for the provided events on fd, to be identified by the provided tag.  A read completes
+ * with the number of bytes read, and a poll completes with the events that are
+ * ready, or either one with a negated errno.  If the submission queue is full, what's
+ * already in it is submitted first.
+ */
+  void prepareRead(int fd, void *buffer, unsigned len, uint64_t tag);
+  void preparePoll(int fd, short events, uint64_t tag);
+
+/**
+ * Method: submit
+ * --------------
+ * Hands every prepared request to the kernel and waits until at least one completion
+ * is available, or until timeout milliseconds have elapsed (-1 means wait indefinitely,
+ * and 0 means don't wait at all), all in a single io_uring_enter.  Returns false if
+ * the wait was cut short by a signal or the timeout.
+ */
+  bool submit(int timeout);
+
+/**
+ * Method: nextCompletion
+ * ----------------------
+ * Removes the oldest completion and places its tag and result in tag and result,
+ * and returns true, or returns false if there are no completions.
+ */
+  bool nextCompletion(uint64_t& tag, int& result);
+
+private:
+  int fd;
+  void *sqRing, *cqRing;
+  size_t sqRingSize, cqRingSize;
+  struct io_uring_sqe *sqes;
+  size_t sqesSize;
+  unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+  unsigned *cqHead, *cqTail, *cqMask;
+  struct io_uring_cqe *cqes;
+  unsigned entries;
+  unsigned tail;    // our copy of the submission queue tail, published by submit
+  unsigned pending; // the number of requests prepared since the last submit
+
+  struct io_uring_sqe *getSQE();
+  int enter(unsigned waitFor, int timeout);
+  void release();
+
+  STSHUring(const STSHUring&) = delete;
+  STSHUring& operator=(const STSHUring&) = delete;
+};
@@ -0,0 +1,288 @@
+/**
+ * File: stsh-zygote.cc
+ * --------------------
+ * Presents the implementation of the zygote, both the shell's side of
+ * the conversation and the helper process itself.
+ */
+
+#include "stsh-zygote.h"
+#include "stsh-launch.h"
+#include "stsh-exception.h"
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+using namespace std;
+
+/**
+ * Types: request, reply, status
+ * -----------------------------
+ * The messages exchanged with the zygote.  A request is followed by the
+ * path and then each of the argc arguments, all '\0'-terminated, and carries
+ * the standard input and output descriptors (whichever of them are present, in that
+ * order) as ancillary data.  Each reply reports a pid, or the errno explaining
+ * why there isn't one, and each status record is one forwarded state change.
+ */
+struct request {
+  pid_t pgid;
+  bool hasInput;
+  bool hasOutput;
+  size_t argc;
+};
+
+struct reply {
+  pid_t pid;
+  int error;
+};
+
+struct status {
+  pid_t pid;
+  int status;
+  struct rusage usage;
+};
+
+static const size_t kMaxRequestSize = 1 << 16;
+
+static int requestfd = -1; // the shell's end of the request socket
+static int statusfd = -1;  // the read end of the status pipe
+
+/**
+ * Function: forwardStatuses
+ * -------------------------
+ * Reaps every child with a state change and queues a status record for each
+ * of them, and then writes as many of the queued records as the status
+ * pipe will take, raising SIGCHLD in the shell if any were written.
+ */
+static void forwardStatuses(vector<status>& pending, int statuses, pid_t shell, bool reap) {
+  while (reap) {
+    status s;
+    s.pid = wait4(-1, &s.status, WNOHANG | WUNTRACED | WCONTINUED, &s.usage);
+    if (s.pid <= 0) break;
+    pending.push_back(s);
+  }
+
+  size_t written = 0;
+  while (written < pending.size() && write(statuses, &pending[written], sizeof(status)) == sizeof(status)) written++;
+  pending.erase(pending.begin(), pending.begin() + written);
+  if (written > 0) kill(shell, SIGCHLD);
+}
+
+/**
+ * Function: serveRequest
+ * ----------------------
+ * Receives one launch request, forks and execs the requested process, and replies
+ * with its pid.  A close-on-exec pipe tells the zygote whether the exec went through,
+ * so a failed exec is reported in the reply and never as a state change.  Returns
+ * false once the shell has closed its end of the socket.
+ */
+static bool serveRequest(int requests) {
+  static char buffer[kMaxRequestSize];
+  request r;
+  struct iovec iov[2] = {{&r, sizeof(r)}, {buffer, sizeof(buffer) - 1}};
+  char control[CMSG_SPACE(2 * sizeof(int))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  ssize_t count = recvmsg(requests, &msg, MSG_CMSG_CLOEXEC);
+  if (count <= 0) return count < 0 && errno == EINTR;
+  buffer[count - sizeof(r)] = '\0';
+
+  int fds[2] = {-1, -1};
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+    memcpy(fds, CMSG_DATA(cmsg), cmsg->cmsg_len - CMSG_LEN(0));
+  int infd = r.hasInput ? fds[0] : -1;
+  int outfd = r.hasOutput ? fds[r.hasInput ? 1 : 0] : -1;
+
+  const char *path = buffer;
+  vector<char *> argv;
+  char *arg = buffer + strlen(path) + 1;
+  for (size_t i = 0; i < r.argc; i++, arg += strlen(arg) + 1) argv.push_back(arg);
+  argv.push_back(NULL);
+
+  int exec[2];
+  pipe2(exec, O_CLOEXEC);
+  reply response = {fork(), 0};
+  if (response.pid == 0) {
+    setpgid(0, r.pgid);
+    if (infd != -1) dup2(infd, STDIN_FILENO);
+    if (outfd != -1) dup2(outfd, STDOUT_FILENO);
+    resetChildSignals();
+    execv(path, argv.data());
+    int error = errno;
+    write(exec[1], &error, sizeof(error));
+    _exit(127);
+  }
+
+  close(exec[1]);
+  if (response.pid == -1) {
+    response.error = errno;
+  } else {
+    setpgid(response.pid, r.pgid);
+    if (read(exec[0], &response.error, sizeof(response.error)) == sizeof(response.error)) {
+      waitpid(response.pid, NULL, 0);
+      response.pid = -1;
+    } else {
+      response.error = 0;
+    }
+  }
+
+  close(exec[0]);
+  if (infd != -1) close(infd);
+  if (outfd != -1) close(outfd);
+  send(requests, &response, sizeof(response), MSG_NOSIGNAL);
+  return true;
+}
+
+/**
+ * Function: runZygote
+ * -------------------
+ * The zygote's entry point.  It moves into its own process group, so keyboard
+ * signals meant for the shell never reach it, becomes a subreaper, so orphaned
+ * descendants of its children are reaped as well, and then serves launch requests
+ * and forwards state changes until the shell goes away.
+ */
+static void runZygote(int requests, int statuses, pid_t shell) {
+  setpgid(0, 0);
+  prctl(PR_SET_CHILD_SUBREAPER, 1);
+  signal(SIGINT, SIG_IGN);
+  signal(SIGTSTP, SIG_IGN);
+  signal(SIGQUIT, SIG_IGN);
+  signal(SIGCHLD, SIG_DFL);
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  sigprocmask(SIG_SETMASK, &mask, NULL);
+  int children = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+
+  vector<status> pending;
+  struct pollfd fds[3] = {{requests, POLLIN, 0}, {children, POLLIN, 0}, {statuses, POLLOUT, 0}};
+  while (true) {
+    if (poll(fds, pending.empty() ? 2 : 3, -1) == -1) continue;
+    if (fds[1].revents & POLLIN) {
+      struct signalfd_siginfo info;
+      while (read(children, &info, sizeof(info)) > 0); // waitpid collects every state change at once
+    }
+
+    forwardStatuses(pending, statuses, shell, fds[1].revents & POLLIN);
+    if ((fds[0].revents & (POLLIN | POLLHUP)) && !serveRequest(requests)) _exit(0);
+  }
+}
+
+void startZygote() {
+  if (zygoteRunning()) return;
+  int sockets[2], statuses[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sockets) == -1)
+    throw STSHException("Could not start the zygote.");
+  if (pipe2(statuses, O_CLOEXEC | O_NONBLOCK) == -1) {
+    close(sockets[0]);
+    close(sockets[1]);
+    throw STSHException("Could not start the zygote.");
+  }
+
+  pid_t shell = getpid();
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(sockets[0]);
+    close(statuses[0]);
+    runZygote(sockets[1], statuses[1], shell);
+  }
+
+  close(sockets[1]);
+  close(statuses[1]);
+  if (pid == -1) {
+    close(sockets[0]);
+    close(statuses[0]);
+    throw STSHException("Could not start the zygote.");
+  }
+
+  requestfd = sockets[0];
+  statusfd = statuses[0];
+}
+
+bool zygoteRunning() {
+  return requestfd != -1;
+}
+
+/**
+ * Function: disconnect
+ * --------------------
+ * Forgets about a zygote that can no longer be reached.  The status pipe is
+ * kept open, so anything it forwarded before going away is still processed.
+ */
+static pid_t disconnect() {
+  close(requestfd);
+  requestfd = -1;
+  errno = ESRCH;
+  return -1;
+}
+
+pid_t zygoteLaunch(const char *path, char *argv[], pid_t pgid, int infd, int outfd) {
+  if (!zygoteRunning()) {
+    errno = ESRCH;
+    return -1;
+  }
+
+  string payload(path, strlen(path) + 1);
+  request r = {pgid, infd != -1, outfd != -1, 0};
+  for (; argv[r.argc] != NULL; r.argc++) payload.append(argv[r.argc], strlen(argv[r.argc]) + 1);
+  if (payload.size() >= kMaxRequestSize) {
+    errno = E2BIG;
+    return -1;
+  }
+
+  struct iovec iov[2] = {{&r, sizeof(r)}, {&payload[0], payload.size()}};
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = 2;
+  int fds[2], numfds = 0;
+  if (infd != -1) fds[numfds++] = infd;
+  if (outfd != -1) fds[numfds++] = outfd;
+  char control[CMSG_SPACE(sizeof(fds))];
+  if (numfds > 0) {
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(numfds * sizeof(int));
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(numfds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, numfds * sizeof(int));
+  }
+
+  if (sendmsg(requestfd, &msg, MSG_NOSIGNAL) == -1) return disconnect();
+  reply response;
+  ssize_t count;
+  do {
+    count = recv(requestfd, &response, sizeof(response), 0);
+  } while (count == -1 && errno == EINTR);
+  if (count != sizeof(response)) return disconnect();
+  if (response.pid == -1) errno = response.error;
+  return response.pid;
+}
+
+int getZygoteStatusFD() {
+  return statusfd;
+}
+
+bool readZygoteStatus(pid_t& pid, int& status, struct rusage& usage) {
+  if (statusfd == -1) return false;
+  struct status s;
+  if (read(statusfd, &s, sizeof(s)) != sizeof(s)) return false;
+  pid = s.pid;
+  status = s.status;
+  usage = s.usage;
+  return true;
+}
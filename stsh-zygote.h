@@ -0,0 +1,64 @@
+/**
+ * File: stsh-zygote.h
+ * -------------------
+ * Defines the interface to the zygote, a small helper process stsh can fork
+ * early on, while its own footprint is still tiny.  Once it's running, the zygote
+ * forks and execs processes on the shell's behalf, so the shell's address space
+ * is never duplicated, however large it grows.
+ *
+ * The shell sends each launch request (the path, the argument vector, the process
+ * group, and the descriptors to install as standard input and output, passed via
+ * SCM_RIGHTS) over a socket, and the zygote replies with the pid of the new process.
+ * Because those processes are the zygote's children and not the shell's, the zygote
+ * reaps them and forwards every state change over a pipe, raising SIGCHLD in the shell
+ * each time, so the shell can process them just as it would its own children.
+ */
+
+#pragma once
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/**
+ * Function: startZygote
+ * ---------------------
+ * Forks the zygote, unless it's already running.  Throws an STSHException
+ * if it can't be started.
+ */
+void startZygote();
+
+/**
+ * Function: zygoteRunning
+ * -----------------------
+ * Returns true iff the zygote has been started and is still reachable.
+ */
+bool zygoteRunning();
+
+/**
+ * Function: zygoteLaunch
+ * ----------------------
+ * Has the zygote launch the executable at path with the provided argument vector,
+ * in the process group pgid (or a new one, if pgid is 0), with infd and outfd
+ * installed as its standard input and output (-1 means leave it alone).
+ * Returns the pid of the new process, or -1 with errno set if it couldn't be
+ * launched.  If the zygote itself has gone away, errno is set to ESRCH, and
+ * zygoteRunning returns false from then on.
+ */
+pid_t zygoteLaunch(const char *path, char *argv[], pid_t pgid, int infd, int outfd);
+
+/**
+ * Function: getZygoteStatusFD
+ * ---------------------------
+ * Returns a descriptor that polls as readable whenever readZygoteStatus has something
+ * to report, or -1 if the zygote was never started.
+ */
+int getZygoteStatusFD();
+
+/**
+ * Function: readZygoteStatus
+ * --------------------------
+ * Retrieves the next state change the zygote has forwarded, as the pid, a
+ * status word, and a resource usage report of the sort wait4 produces.  Returns
+ * false if none are pending.  This never blocks and is async-signal-safe, so it can
+ * be called from a SIGCHLD handler.
+ */
+bool readZygoteStatus(pid_t& pid, int& status, struct rusage& usage);
@@ -11,9 +11,16 @@
 #include "stsh-job-list.h"
 #include "stsh-job.h"
 #include "stsh-process.h"
+#include "stsh-launch.h"
+#include "stsh-zygote.h"
+#include "stsh-inprocess.h"
+#include "stsh-event-loop.h"
+#include "stsh-parse-utils.h"
 #include <cstring>
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <vector>
 #include <algorithm>
 #include <fcntl.h>
 #include <unistd.h>  // for fork
@@ -23,9 +30,18 @@
 using namespace std;
 
 static STSHJobList joblist; // the one piece of global data we need so signal handlers can access it
+static STSHEventLoop *eventLoop; // processes every change to the job list's processes
 static void fgBuiltin(const pipeline& pipeline, size_t index);
 static void bgBuiltin(const pipeline& pipeline, size_t index);
 static void SHCBuiltin(const pipeline& pipeline, size_t index);
+static void launchBuiltin(const pipeline& pipeline);
+static void hashBuiltin(const pipeline& pipeline);
+static void statsBuiltin(const pipeline& pipeline);
+static void jobsBuiltin(const pipeline& pipeline);
+static void writeOutput(const string& text);
+static void inProcessBuiltin(const pipeline& pipeline);
+static void timeoutBuiltin(pipeline& pipeline);
+static void createJob(const pipeline& p, double timeout = 0);
 
 
 /**
@@ -35,9 +51,14 @@ static void SHCBuiltin(const pipeline& pipeline, size_t index);
  * it's a shell builtin, and if so, handles and executes it.  handleBuiltin
  * returns true if the command is a builtin, and false otherwise.
  */
-static const string kSupportedBuiltins[] = {"quit", "exit", "fg", "bg", "slay", "halt", "cont", "jobs"};
+static const string kSupportedBuiltins[] = {"quit", "exit", "fg", "bg", "slay", "halt", "cont", "jobs", "launch", "hash", "stats", "timeout"};
 static const size_t kNumSupportedBuiltins = sizeof(kSupportedBuiltins)/sizeof(kSupportedBuiltins[0]);
-static bool handleBuiltin(const pipeline& pipeline) {
+static bool handleBuiltin(pipeline& pipeline) {
+  if (pipeline.commands.size() == 1 && isInProcessCommand(pipeline.commands[0])) {
+    inProcessBuiltin(pipeline);
+    return true;
+  }
+
   const string& command = pipeline.commands[0].command;
   auto iter = find(kSupportedBuiltins, kSupportedBuiltins + kNumSupportedBuiltins, command);
   if (iter == kSupportedBuiltins + kNumSupportedBuiltins) return false;
@@ -49,7 +70,11 @@ static bool handleBuiltin(const pipeline& pipeline) {
   case 2: fgBuiltin(pipeline, index); break;
   case 3: bgBuiltin(pipeline, index); break;
   case 4: case 5: case 6: SHCBuiltin(pipeline, index); break;
-  case 7: cout << joblist; break;
+  case 7: jobsBuiltin(pipeline); break;
+  case 8: launchBuiltin(pipeline); break;
+  case 9: hashBuiltin(pipeline); break;
+  case 10: statsBuiltin(pipeline); break;
+  case 11: timeoutBuiltin(pipeline); break;
   default: throw STSHException("Internal Error: Builtin command not supported."); 
   }
   
@@ -62,6 +87,27 @@ static bool handleBuiltin(const pipeline& pipeline) {
 
 
 
+/**
+ * Function: getJobNumbers
+ * -----------------------
+ * Returns the number of every job named by the provided list of job numbers and
+ * ranges (e.g. 3-40,45, optionally preceded by a %), skipping numbers no job has,
+ * and throws an STSHException if the list is malformed or names no jobs at all.
+ */
+static vector<size_t> getJobNumbers(const char *spec, const string& usage, const string& builtin) {
+  if (spec != NULL && spec[0] == '%') spec++;
+  vector<size_t> nums;
+  for (const pair<size_t, size_t>& range: parseNumberRanges(spec, usage)) {
+    vector<size_t> found = joblist.getJobNumbers(range.first, range.second);
+    nums.insert(nums.end(), found.begin(), found.end());
+  }
+
+  sort(nums.begin(), nums.end());
+  nums.erase(unique(nums.begin(), nums.end()), nums.end());
+  if (nums.empty()) throw STSHException(builtin + " " + spec + ":  No such job.");
+  return nums;
+}
+
 /**
  * Function: fgBuiltin
  * -------------------------
@@ -76,190 +122,265 @@ static void fgBuiltin(const pipeline& pipeline, size_t index) {
   if ((strlen(first) > 0 && strlen(ptr) > 0) || ret < 0) throw STSHException("Usage: fg <jobid>.");
   if (!joblist.containsJob(num)) throw STSHException("fg " + to_string(num) + ":  No such job.");
   STSHJob& job = joblist.getJob(num);
-  vector<STSHProcess>& processes = job.getProcesses();
-  sigset_t mask, existing;
-  sigemptyset(&mask);
-  sigaddset(&mask, SIGINT);
-  sigaddset(&mask, SIGCHLD);
-  sigaddset(&mask, SIGTSTP);
-  sigaddset(&mask, SIGCONT);
-  sigprocmask(SIG_BLOCK, &mask, &existing);
-  for (auto process: processes) {
-    if (kill(process.getID(), SIGCONT) == 0) job.setState(kForeground);
+  if (job.signal(SIGCONT) == 0) {
+    for (STSHProcess& process: job.getProcesses()) { // so synchronize doesn't send it right back to the background
+      if (process.getState() == kStopped) job.setProcessState(process, kRunning);
+    }
+
+    joblist.setState(job, kForeground);
   }
+
   joblist.synchronize(job);
-  while(joblist.hasForegroundJob()) sigsuspend(&existing);
-  sigprocmask(SIG_UNBLOCK, &mask, NULL);
+  eventLoop->waitForForegroundJob();
 }
 
 
 /**
  * Function: bgBuiltin
  * ----------------------
- *
+ * Continues every job in the provided list (see getJobNumbers) in the background.
  */
 static void bgBuiltin(const pipeline& pipeline, size_t index) {
-  char* first = pipeline.commands[0].tokens[0];
-  if (first == NULL) throw STSHException("Usage: bg <jobid>.");
-  pid_t num = atoi(first);
-  char* ptr;
-  long ret = strtol(first, &ptr, 10);
-  if ((strlen(first) > 0 && strlen(ptr) > 0) || ret < 0) throw STSHException("Usage: bg <jobid>.");
-  if (!joblist.containsJob(num)) throw STSHException("bg " + to_string(num) + ":  No such job.");
-  STSHJob& job = joblist.getJob(num);
-  vector<STSHProcess>& processes = job.getProcesses();
-  for (auto process: processes) kill(process.getID(), SIGCONT);
-  joblist.synchronize(job);
+  static const string kUsage = "Usage: bg <jobid>[-<jobid>][,...].";
+  if (pipeline.commands[0].tokens[0] == NULL || pipeline.commands[0].tokens[1] != NULL) throw STSHException(kUsage);
+  for (size_t num: getJobNumbers(pipeline.commands[0].tokens[0], kUsage, "bg")) {
+    STSHJob& job = joblist.getJob(num);
+    job.signal(SIGCONT);
+    joblist.synchronize(job);
+  }
 }
 
 /**
  * Function: SHCBuiltin
  * ----------------------
- * Support for Slay, Halt, Continue builtins
+ * Support for Slay, Halt, Continue builtins, which send SIGKILL, SIGSTOP, and SIGCONT
+ * respectively to one of three targets:
+ *
+ *   <jobid> <index>:  the process at that index within that job
+ *   <pid>:            that process
+ *   <jobs>:           every process of every job in the list, e.g. 3-40,45 (see getJobNumbers),
+ *                     one killpg per job.  A single job has to be written %<jobid>.
  */
-
+static const int kSHCSignals[] = {SIGKILL, SIGSTOP, SIGCONT}; // for slay, halt, and cont, in that order
 static void SHCBuiltin(const pipeline& pipeline, size_t index){
   char* first = pipeline.commands[0].tokens[0];
   char* second = pipeline.commands[0].tokens[1];
-  int killer;
-  switch(index) {
-  case 4: killer = SIGKILL;
-  case 5: killer = SIGSTOP;
-  case 6: killer = SIGCONT;
-  }
-  string builtin;
-  switch(index) {
-  case 4: builtin = "slay";
-  case 5: builtin = "halt";
-  case 6: builtin = "cont";
-  }
-  if (first == NULL)  throw STSHException("Usage: " + builtin + " <jobid> <index> | <pid>.");
-  pid_t num = atoi(first);
-  char* ptr;
-  long ret = strtol(first, &ptr, 10);
-  if (second == NULL) {
-    if ((strlen(first) > 0 && strlen(ptr) > 0) || ret < 0) throw STSHException("Usage: bg <jobid>.");
-    if (!joblist.containsProcess(num)) throw STSHException("No process with pid " + to_string(num) + ".");
-    STSHJob& job = joblist.getJobWithProcess(num);
-    vector<STSHProcess>& processes = job.getProcesses();
-    for (auto process: processes) kill(process.getID(), killer);
-  } else if (second != NULL) {
+  int killer = kSHCSignals[index - 4];
+  const string& builtin = kSupportedBuiltins[index];
+  string usage = "Usage: " + builtin + " <jobid> <index> | <pid> | %<jobid>[-<jobid>][,...].";
+  if (first == NULL || (second != NULL && pipeline.commands[0].tokens[2] != NULL)) throw STSHException(usage);
+  if (second != NULL) {
+    size_t num = parseNumber(first, usage), pos = parseNumber(second, usage);
     if (!joblist.containsJob(num)) throw STSHException("No job with id of " + to_string(num) + ".");
-    STSHJob& job = joblist.getJob(num);
-    pid_t pid = atoi(second);
-    if (!job.containsProcess(pid)) throw STSHException("No process pid " + to_string(pid) + ".");
-    STSHProcess process = job.getProcess(pid);
-    kill(process.getID(), killer);
+    vector<STSHProcess>& processes = joblist.getJob(num).getProcesses();
+    if (pos >= processes.size()) throw STSHException("Job " + to_string(num) + " doesn't have a process at index " + to_string(pos) + ".");
+    processes[pos].signal(killer);
+  } else if (first[0] == '%' || strpbrk(first, "-,") != NULL) {
+    for (size_t num: getJobNumbers(first, usage, builtin)) joblist.getJob(num).signal(killer);
+  } else {
+    pid_t pid = parseNumber(first, usage);
+    if (!joblist.containsProcess(pid)) throw STSHException("No process with pid " + to_string(pid) + ".");
+    joblist.getProcess(pid).signal(killer);
   }
 }
 
 
-/************************************************************************************************************/
-/* Signal Handlers */
-/************************************************************************************************************/
+/**
+ * Function: jobsBuiltin
+ * ---------------------
+ * Lists every job, or just the running ones (-r), the stopped ones (-s), or those
+ * including any of the provided pids, along with the resources each of their terminated
+ * processes used if -v is specified.  --json lists them as a JSON array of objects
+ * (see STSHJob::appendJSON) instead, for scripts to consume.  However many jobs there
+ * are, the whole listing is rendered into one string and written all at once.
+ */
+static const size_t kListingBytesPerJob = 96;
+static void jobsBuiltin(const pipeline& pipeline) {
+  static const string kUsage = "Usage: jobs [-v] [-r | -s] [--json] [<pid> ...].";
+  bool verbose = false, running = false, stopped = false, json = false, byPid = false;
+  vector<size_t> nums;
+  for (char* const* tokenp = pipeline.commands[0].tokens; *tokenp != NULL; tokenp++) {
+    const char *token = *tokenp;
+    if (strcmp(token, "-v") == 0) verbose = true;
+    else if (strcmp(token, "-r") == 0) running = true;
+    else if (strcmp(token, "-s") == 0) stopped = true;
+    else if (strcmp(token, "--json") == 0) json = true;
+    else {
+      pid_t pid = parseNumber(token, kUsage);
+      if (!joblist.containsProcess(pid)) throw STSHException("No process with pid " + to_string(pid) + ".");
+      nums.push_back(joblist.getJobWithProcess(pid).getNum());
+      byPid = true;
+    }
+  }
+
+  if (running && stopped) throw STSHException(kUsage);
+  if (byPid) {
+    sort(nums.begin(), nums.end());
+    nums.erase(unique(nums.begin(), nums.end()), nums.end());
+  } else {
+    nums = joblist.getJobNumbers(1, SIZE_MAX);
+  }
+
+  string listing;
+  listing.reserve(kListingBytesPerJob * (nums.size() + 1));
+  if (json) listing += '[';
+  bool listed = false;
+  for (size_t num: nums) {
+    const STSHJob& job = joblist.getJob(num);
+    if ((running && !job.isRunning()) || (stopped && !job.isStopped())) continue;
+    if (json) {
+      if (listed) listing += ',';
+      job.appendJSON(listing);
+    } else {
+      job.append(listing, verbose);
+      listing += '\n';
+    }
+
+    listed = true;
+  }
 
+  if (json) listing += "]\n";
+  writeOutput(listing);
+}
 
 /**
- * Function: reapChild
+ * Function: launchBuiltin
  * -----------------------
- * reap any children who has terminated/stopped.
- * and update the process state.
+ * Prints the name of the launch engine used to create new processes, or
+ * switches to the named one.
  */
-
-void sigchldHandler(int sig) {
-  while(1) {
-    pid_t pid;
-    int status;
-    STSHProcessState state;
-    pid = waitpid(-1, &status, WNOHANG|WUNTRACED|WCONTINUED);
-    if (pid <= 0) break;
-    if(WIFEXITED(status))  state = kTerminated;
-    if (WIFCONTINUED(status))  state = kRunning;
-    if (WIFSIGNALED(status))  state = kTerminated;
-    if (WIFSTOPPED(status))  state = kStopped;
-
-    STSHJob& job = joblist.getJobWithProcess(pid);
-    assert(job.containsProcess(pid));
-    job.getProcess(pid).setState(state);
-    joblist.synchronize(job);
+static void launchBuiltin(const pipeline& pipeline) {
+  char* name = pipeline.commands[0].tokens[0];
+  if (name == NULL) {
+    cout << getLaunchEngineName() << endl;
+    return;
   }
-}
 
+  if (pipeline.commands[0].tokens[1] != NULL || !setLaunchEngine(name))
+    throw STSHException("Usage: launch [fork | spawn | clone | zygote].");
+}
 
 /**
- * Function: siginHandler
- * ---------------------------------------
- * Custom Handler to forward SIGINT to the
- * foreground job, if exist.
+ * Function: hashBuiltin
+ * ---------------------
+ * Lists the commands whose locations have been remembered, forgets all of
+ * them along with the exec cache's descriptors (hash -r), or looks up and remembers
+ * the named commands.
  */
+static void hashBuiltin(const pipeline& pipeline) {
+  STSHCommandHash& hash = getCommandHash();
+  char* const* tokens = pipeline.commands[0].tokens;
+  if (tokens[0] == NULL) {
+    if (hash.empty()) cout << "hash: hash table empty" << endl;
+    else cout << hash;
+    return;
+  }
+
+  if (strcmp(tokens[0], "-r") == 0) {
+    if (tokens[1] != NULL) throw STSHException("Usage: hash [-r] [<command> ...].");
+    hash.clear();
+    getExecCache().clear();
+    return;
+  }
 
-void sigintHandler(int sig) {
-  if (joblist.hasForegroundJob()) {
-    STSHJob& job = joblist.getForegroundJob();
-    std::vector<STSHProcess>& processes = job.getProcesses();
-    for (auto process: processes) kill(process.getID(), SIGINT);
+  for (size_t i = 0; tokens[i] != NULL; i++) {
+    string path;
+    if (!hash.lookup(tokens[i], path)) throw STSHException("hash: " + string(tokens[i]) + ": not found");
   }
 }
 
 /**
- * Function: sigtstpHandler
- * -----------------------------------------
- *  Custom Handler to forward SIGTSTP to the
- * foreground job, if exist.
+ * Function: statsBuiltin
+ * ----------------------
+ * Reports how well the exec cache is doing.
  */
+static void statsBuiltin(const pipeline& pipeline) {
+  if (pipeline.commands[0].tokens[0] != NULL) throw STSHException("Usage: stats.");
+  cout << getExecCache();
+}
 
-void sigtstpHandler(int sig) {
-  if (joblist.hasForegroundJob()) {
-    STSHJob& job = joblist.getForegroundJob();
-    std::vector<STSHProcess>& processes = job.getProcesses();
-    for (auto process: processes) kill(process.getID(), SIGTSTP);
-  }
+/**
+ * Function: timeoutBuiltin
+ * ------------------------
+ * Runs the rest of the pipeline as a job that must finish within the provided
+ * number of seconds (see STSHEventLoop::setDeadline).  The leading "timeout <secs>"
+ * is stripped from the first command in place, so the pipeline is launched as if it
+ * had been typed without it.
+ */
+static void timeoutBuiltin(pipeline& pipeline) {
+  command& first = pipeline.commands[0];
+  char *secs = first.tokens[0], *end = NULL;
+  double limit = secs == NULL ? 0 : strtod(secs, &end);
+  if (secs == NULL || *end != '\0' || !(limit > 0) || first.tokens[1] == NULL || strlen(first.tokens[1]) > kMaxCommandLength)
+    throw STSHException("Usage: timeout <secs> <pipeline>.");
+  strcpy(first.command, first.tokens[1]);
+  free(first.tokens[0]);
+  free(first.tokens[1]);
+  memmove(first.tokens, first.tokens + 2, (kMaxArguments - 1) * sizeof(char *));
+  first.tokens[kMaxArguments - 1] = first.tokens[kMaxArguments] = NULL;
+  createJob(pipeline, limit);
 }
 
+/**
+ * Function: inProcessBuiltin
+ * --------------------------
+ * Runs a lone in-process command (see stsh-inprocess.h) without creating a job,
+ * honoring its redirections.  The input file is opened, as it would be for
+ * any other command, but never read.
+ */
+static void inProcessBuiltin(const pipeline& pipeline) {
+  int infd = openRedirection(pipeline.input, O_RDONLY);
+  if (infd != -1) close(infd);
+  int outfd = openRedirection(pipeline.output, O_WRONLY | O_CREAT | O_TRUNC);
+  runInProcessCommand(pipeline.commands[0], outfd == -1 ? STDOUT_FILENO : outfd);
+  if (outfd != -1) close(outfd);
+}
+
+
+/************************************************************************************************************/
+/* Signal Handlers */
+/************************************************************************************************************/
+
+
 /**
  * Function: installSignalHandlers
  * -------------------------------
- * Installs user-defined signals handlers for four signals
- * (once you've implemented signal handlers for SIGCHLD, 
- * SIGINT, and SIGTSTP, you'll add more installSignalHandler calls) and 
- * ignores two others.
+ * Installs a user-defined handler for SIGQUIT and ignores two
+ * other signals, and then creates the event loop selected via STSH_EVENT_LOOP
+ * (epoll, unless told otherwise, or unless it can't be set up), which takes over SIGCHLD, SIGINT, and SIGTSTP.
+ * See stsh-event-loop.h for the details.
  *
  * installSignalHandler is a wrapper around a more robust version of the
  * signal function we've been using all quarter.  Check out stsh-signal.cc
  * to see how it works.
  */
+static const char *const kDefaultEventLoop = "epoll";
+static const char *const kFallbackEventLoop = "signals"; // needs nothing beyond sigaction
 static void installSignalHandlers() {
-  installSignalHandler(SIGQUIT, [](int sig) { exit(0); });
+  installSignalHandler(SIGQUIT, [](int sig) { _exit(0); }); // exit isn't async-signal-safe
   installSignalHandler(SIGTTIN, SIG_IGN);
   installSignalHandler(SIGTTOU, SIG_IGN);
-  installSignalHandler(SIGCHLD, sigchldHandler);
-  installSignalHandler(SIGINT, sigintHandler);
-  installSignalHandler(SIGTSTP, sigtstpHandler);
+  const char *name = getenv("STSH_EVENT_LOOP");
+  try {
+    if (name != NULL) {
+      eventLoop = STSHEventLoop::create(name, joblist);
+      if (eventLoop == NULL) cerr << "Unknown event loop \"" << name << "\"." << endl;
+    }
+
+    if (eventLoop == NULL) eventLoop = STSHEventLoop::create(kDefaultEventLoop, joblist);
+  } catch (const STSHException& e) {
+    cerr << e.what() << endl;
+    eventLoop = STSHEventLoop::create(kFallbackEventLoop, joblist);
+  }
+
+  rlsetinputhook([](int fd) { eventLoop->waitForInput(fd); });
 }
 
 /************************************************************************************************************/
-/* Dup2, Print Background process  */
+/* Print Background process  */
 /************************************************************************************************************/
 
 
-/**
- * Function: Dup2
- * ----------------
- */
-void Dup2(int infd1, int infd2) {
-  dup2(infd1, infd2) ;
-  close(infd1) ;
-}
-
-/**
- * Function: Close
- * ---------------
- */
-void Close(int* fd) {
-  close(fd[0]);
-  close(fd[1]);
-}
-
 /**
  * Function: printBG
  * --------------------------
@@ -267,89 +388,32 @@ void Close(int* fd) {
 void printBG(STSHJob& job) {
   vector<STSHProcess>& processes = job.getProcesses();
   cout << "[" << job.getNum() << "]";
-  for (auto process: processes) cout << " "<< process.getID();
+  for (const STSHProcess& process: processes) cout << " "<< process.getID();
   cout << endl;
 }
 
 /**
  * Function: createJob
  * -------------------
- * Creates a new job on behalf of the provided pipeline.
+ * Creates a new job on behalf of the provided pipeline, which must finish within
+ * timeout seconds, unless timeout is 0.  Must be called with the event loop locked.
+ * A foreground pipeline ending in an in-process command isn't done until that command's
+ * thread is, which is waited for with the event loop unlocked.
  */
-static void createJob(const pipeline& p) {
-  
-  ///* STSHJob& job = */ joblist.addJob(kForeground);
-  
+static void createJob(const pipeline& p, double timeout) {
   STSHJobState state = (p.background) ? kBackground : kForeground;
   STSHJob& job = joblist.addJob(state);
 
-  sigset_t existing, mask;
-  sigemptyset(&mask);
-  sigaddset(&mask, SIGCHLD);
-  sigaddset(&mask, SIGINT);
-  sigaddset(&mask, SIGTSTP);
-  sigaddset(&mask, SIGCONT);
-
-  int count = p.commands.size();
-  int fds[count][2];
-
-  int infd = (!p.input.empty()) ? open(p.input.c_str(), O_RDONLY) : 0;
-  int outfd = (!p.output.empty()) ? open(p.output.c_str(), O_WRONLY|O_TRUNC) : 0;
-  if (outfd == -1) outfd = open(p.output.c_str(), O_WRONLY|O_CREAT, 0644);
-
-    for (size_t i = 0; i < count - 1; i++) pipe(fds[i]);
-   
-  for(size_t i = 0; i < count; i++) {
-    command cmd =  p.commands[i];
-    pid_t pid = fork();
-    if(pid == 0) {                              //Child process
-      setpgid(pid, job.getGroupID());
-      if (count == 1) {                                   
-	if(!p.input.empty())   Dup2(infd, STDIN_FILENO);
-	if(!p.output.empty())  Dup2(outfd, STDOUT_FILENO);
-      } else {
-	if(i == 0) {                                       // Set infd as STDIN_FILENO file descriptor
-	  if(!p.input.empty())   Dup2(infd, STDIN_FILENO);
-	  close(fds[0][0]);
-	  Dup2(fds[0][1], STDOUT_FILENO);
-	  Close(fds[count]);
-	} else if(i == count - 1) {                        // Set outfd as STDOUT_FILENO file descriptor
-	  if(!p.output.empty())   Dup2(outfd, STDOUT_FILENO);
-	  close(fds[i - 1][1]);
-	  Dup2(fds[i - 1][0], STDIN_FILENO);
-	  Close(fds[0]);
-	} else {                                           // Connect all other file descriptors via pipes
-	  close(fds[i - 1][1]);
-	  Dup2(fds[i - 1][0], STDIN_FILENO);
-	  close(fds[i][0]);
-	  Dup2(fds[i][1], STDOUT_FILENO);
-     	  Close(fds[0]);
-	  Close(fds[count - 1]);
-      	}
-
-	for(int j = 1; j < count - 2; j++) Close(fds[j]);
-      }
-
-      size_t len = sizeof(cmd.tokens)/sizeof(cmd.tokens[0]); // Execute lines
-      char* args[len + 3];
-      args[0] = const_cast<char *>(cmd.command);
-      for (size_t i = 0; i <= len; i++) {
-	args[i + 1] = const_cast<char *>(cmd.tokens[i]);
-      }
-      args[len + 2] = NULL;
-      string str(args[0]);
-
-      if (execvp(args[0], args) < 0) throw STSHException(str + ": Command not found.");
-    } else {                                                 // Parent Process
-      job.addProcess(STSHProcess(pid, cmd));                 // Add the process in child, to Parent
-      setpgid(pid, job.getGroupID());                        // change the process's Group id
-    }
-  }
-  
-  for(size_t i = 0; i < count - 1; i++) {
-    Close(fds[i]);
+  int done;
+  try {
+    done = launchPipeline(p, joblist, job);
+  } catch (const STSHException& e) {
+    joblist.synchronize(job);
+    throw;
   }
 
+  eventLoop->watch(job);
+  if (timeout > 0) eventLoop->setDeadline(job, timeout);
   if(p.background) printBG(job);                             // Print out background job id.s
   
   if(joblist.hasForegroundJob()) {
@@ -358,11 +422,50 @@ static void createJob(const pipeline& p) {
 
   if(tcsetpgrp(STDIN_FILENO, getpgid(getpid())) == -1 && errno != ENOTTY) throw STSHException("authority error.");
   
-  sigprocmask(SIG_BLOCK, &mask, &existing);
- 
-  while(joblist.hasForegroundJob())  sigsuspend(&existing); 
-  sigprocmask(SIG_UNBLOCK, &mask, NULL);
-  
+  joblist.synchronize(job);                                  // a pipeline where nothing launched is already done
+  eventLoop->waitForForegroundJob();
+  if (done == -1) return;
+  if (!p.background) {
+    eventLoop->unlock();                                     // so events are processed while it writes
+    eventLoop->waitForInput(done);                           // until its thread hangs up
+    eventLoop->lock();
+  }
+
+  close(done);
+}
+
+/**
+ * Function: writeOutput
+ * ---------------------
+ * Writes the provided text straight to standard output, in a single write unless
+ * it's interrupted or cut short, after flushing whatever cout has buffered so the
+ * two stay in order.
+ */
+static void writeOutput(const string& text) {
+  if (text.empty()) return;
+  cout.flush();
+  for (size_t written = 0; written < text.size();) {
+    ssize_t count = write(STDOUT_FILENO, text.data() + written, text.size() - written);
+    if (count == -1 && errno == EINTR) continue;
+    if (count <= 0) return;
+    written += count;
+  }
+}
+
+/**
+ * Function: printNotifications
+ * ----------------------------
+ * Catches up on every event that has already arrived, and then prints every
+ * notification the job list has queued up about background jobs finishing or jobs stopping,
+ * all in one write, so that a burst of exits doesn't turn into a burst of
+ * writes to the terminal.
+ */
+static void printNotifications() {
+  eventLoop->poll();
+  eventLoop->lock();
+  string notifications = joblist.takeNotifications();
+  eventLoop->unlock();
+  writeOutput(notifications);
 }
 
 /**
@@ -373,21 +476,30 @@ static void createJob(const pipeline& p) {
  * loop (i.e. a repl).  
  */
 int main(int argc, char *argv[]) {
-  pid_t stshpid = getpid();
+  raiseDescriptorLimit(); // every process holds a pidfd
+  const char *engine = getenv("STSH_LAUNCH_ENGINE"); // selected here, a zygote starts while stsh is tiny
+  try {
+    if (engine != NULL && !setLaunchEngine(engine)) cerr << "Unknown launch engine \"" << engine << "\"." << endl;
+  } catch (const STSHException& e) {
+    cerr << e.what() << endl;
+  }
   installSignalHandlers();
   rlinit(argc, argv);
   while (true) {
+    printNotifications();
     string line;
     if (!readline(line)) break;
     if (line.empty()) continue;
+    eventLoop->poll(); // so builtins like jobs see every change so far
+    eventLoop->lock(); // and so nothing changes under them, and nothing is reaped before it's in the job list
     try {
       pipeline p(line);
       bool builtin = handleBuiltin(p);
       if (!builtin) createJob(p);
     } catch (const STSHException& e) {
       cerr << e.what() << endl;
-      if (getpid() != stshpid) exit(0); // if exception is thrown from child process, kill it
     }
+    eventLoop->unlock();
   }
 
   return 0;